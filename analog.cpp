@@ -0,0 +1,202 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "analog.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+namespace
+{
+	using Analog::channelCount;
+	using Analog::oversamplingBits;
+
+	static_assert( oversamplingBits <= 3, "the sum of 4^n 10-bit samples must fit in 16 bits");
+	constexpr uint8_t samplesPerValue = 1 << (2 * oversamplingBits);
+
+	/// ADMUX value, reference and input, for each channel.
+	const uint8_t multiplexer[channelCount] = {
+			_BV( REFS0) | 0,                      // light
+			_BV( REFS1) | _BV( REFS0) | _BV( MUX3), // temperature
+	};
+
+	/// conversions to throw away after switching channels, while the
+	/// sample-and-hold capacitor and, after a change of reference, the
+	/// capacitor on AREF settle.
+	constexpr uint8_t settleSamples = 32;
+
+	volatile uint16_t values[channelCount];
+	volatile uint8_t ready = 0;
+
+	uint16_t lowThreshold[channelCount];
+	uint16_t highThreshold[channelCount];
+	uint8_t above = 0;
+
+	// state of the interrupt routine
+	uint8_t current = 0;
+	uint8_t discard = settleSamples;
+	uint8_t count = 0;
+	uint16_t sum = 0;
+
+	constexpr uint8_t crossingCapacity = 4;
+	Analog::Crossing crossings[crossingCapacity];
+	volatile uint8_t crossingHead = 0;
+	volatile uint8_t crossingTail = 0;
+
+	void AddCrossing( uint8_t channel, bool isAbove, uint16_t value)
+	{
+		if (static_cast<uint8_t>( crossingHead - crossingTail) == crossingCapacity) return;
+		crossings[crossingHead & (crossingCapacity - 1)] = Analog::Crossing{ static_cast<Analog::Channel>( channel), isAbove, value};
+		++crossingHead;
+	}
+
+	/**
+	 * Compare a new value against the thresholds of its channel.
+	 */
+	void CheckThresholds( uint8_t channel, uint16_t value)
+	{
+		const uint8_t mask = 1 << channel;
+		if (not (above & mask) and value > highThreshold[channel])
+		{
+			above |= mask;
+			AddCrossing( channel, true, value);
+		}
+		else if ((above & mask) and value < lowThreshold[channel])
+		{
+			above &= ~mask;
+			AddCrossing( channel, false, value);
+		}
+	}
+}
+
+ISR( ADC_vect)
+{
+	const uint16_t sample = ADC;
+	if (discard)
+	{
+		--discard;
+	}
+	else
+	{
+		sum += sample;
+		if (++count == samplesPerValue)
+		{
+			const uint16_t value = sum >> oversamplingBits;
+			values[current] = value;
+			ready |= 1 << current;
+			CheckThresholds( current, value);
+
+			sum = 0;
+			count = 0;
+			if (++current == channelCount) current = 0;
+			if (channelCount > 1)
+			{
+				ADMUX = multiplexer[current];
+				discard = settleSamples;
+			}
+		}
+	}
+	ADCSRA |= _BV( ADSC);
+}
+
+namespace Analog
+{
+	/**
+	 * Start sampling all channels. Thresholds are initially set so that no
+	 * crossings are reported.
+	 */
+	void Start()
+	{
+		for (uint8_t channel = 0; channel < channelCount; ++channel)
+		{
+			lowThreshold[channel] = 0;
+			highThreshold[channel] = maximum;
+		}
+
+		DIDR0 = _BV( 0); // no digital input buffer on ADC0
+		ADMUX = multiplexer[0];
+
+		// ADC clock of 8MHz/128 = 62.5kHz, about 4800 conversions per second.
+		ADCSRA = _BV( ADEN) | _BV( ADSC) | _BV( ADIE) | _BV( ADPS2) | _BV( ADPS1) | _BV( ADPS0);
+	}
+
+	/**
+	 * Stop sampling after the current conversion, without losing the samples
+	 * collected so far.
+	 */
+	void Pause()
+	{
+		ADCSRA &= ~_BV( ADIE);
+	}
+
+	/**
+	 * Continue sampling after Pause(). A conversion that completed in the
+	 * meantime is still pending and is handled by the interrupt right away.
+	 */
+	void Resume()
+	{
+		// writing a one to ADIF would clear the pending conversion.
+		ADCSRA = (ADCSRA & ~_BV( ADIF)) | _BV( ADIE) | _BV( ADSC);
+	}
+
+	/**
+	 * Return true if a new value was decimated since the last call to Read()
+	 * for the given channel.
+	 */
+	bool Ready( Channel channel)
+	{
+		return ready & (1 << channel);
+	}
+
+	/**
+	 * Return the latest value of the given channel, 0 to Analog::maximum.
+	 */
+	uint16_t Read( Channel channel)
+	{
+		uint16_t value;
+		ATOMIC_BLOCK( ATOMIC_RESTORESTATE)
+		{
+			ready &= ~(1 << channel);
+			value = values[channel];
+		}
+		return value;
+	}
+
+	/**
+	 * Take the oldest threshold crossing from the ring buffer. Returns false if
+	 * there was none.
+	 */
+	bool NextCrossing( Crossing &crossing)
+	{
+		bool found = false;
+		ATOMIC_BLOCK( ATOMIC_RESTORESTATE)
+		{
+			if (crossingHead != crossingTail)
+			{
+				crossing = crossings[crossingTail & (crossingCapacity - 1)];
+				++crossingTail;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	/**
+	 * Set the thresholds of a channel. A crossing is reported when the value
+	 * rises above high and when it drops below low again, the difference acts
+	 * as hysteresis.
+	 */
+	void SetThresholds( Channel channel, uint16_t low, uint16_t high)
+	{
+		ATOMIC_BLOCK( ATOMIC_RESTORESTATE)
+		{
+			lowThreshold[channel] = low;
+			highThreshold[channel] = high;
+		}
+	}
+}
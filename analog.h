@@ -0,0 +1,56 @@
+/*
+ * analog.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef ANALOG_H_
+#define ANALOG_H_
+#include <stdint.h>
+
+/**
+ * Interrupt-driven background sampling of analog inputs.
+ *
+ * Once started, the ADC converts continuously. The ADC interrupt adds up
+ * 4^n samples of a channel, decimates them into a value with n extra bits of
+ * resolution and then moves on to the next channel. Reading the latest value of
+ * a channel is therefore just a memory access.
+ *
+ * Each channel has a low and a high threshold. When a value rises above the
+ * high threshold or falls below the low one, the interrupt adds a Crossing to a
+ * small ring buffer, which the main loop empties with NextCrossing().
+ *
+ * Sampling interrupts the processor about every 100us. Code that times
+ * itself by counting cycles must Pause() the sampler and Resume() it afterwards.
+ */
+namespace Analog
+{
+	enum Channel : uint8_t
+	{
+		light,        ///< light dependent resistor on ADC0, AVcc reference
+		temperature,  ///< internal temperature sensor, 1.1V reference
+		channelCount
+	};
+
+	struct Crossing
+	{
+		Channel channel;
+		bool above;
+		uint16_t value;
+	};
+
+	void Start();
+	void Pause();
+	void Resume();
+	bool Ready( Channel channel);
+	uint16_t Read( Channel channel);
+	bool NextCrossing( Crossing &crossing);
+	void SetThresholds( Channel channel, uint16_t low, uint16_t high);
+
+	/// values have 12 bits of resolution.
+	constexpr uint8_t oversamplingBits = 2;
+	constexpr uint16_t maximum = (1U << (10 + oversamplingBits)) - 1;
+}
+
+#endif /* ANALOG_H_ */
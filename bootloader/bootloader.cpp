@@ -0,0 +1,301 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/**
+ * Serial bootloader for the remote wall switch firmware.
+ *
+ * The bootloader lives in the 2KB boot section of the atmega328p and talks
+ * over the same UART that the application uses for esp-link. Firmware images
+ * are sent by tools/update_firmware.py through the transparent TCP-to-serial
+ * bridge of esp-link. See README.md in this directory for build instructions
+ * and fuse settings.
+ *
+ * Protocol, all multi-byte values are big-endian:
+ *   sync(4) 'H'                       -> 'B', page size
+ *   'W' address(2) data(page size) crc(2) -> 'K' when accepted, 'E' otherwise
+ *   sync(4) 'Q'                       -> 'K', then the application is started,
+ *                                        'E' if there is no application
+ *
+ * After the reset, esp-link may still be sending SLIP frames for a while, so
+ * hello and quit must be preceded by the sync word, which is unlikely to appear
+ * in that traffic, and page writes are only accepted after a hello.
+ *
+ * The CRC is a CRC-16/XMODEM over the address and the data. A page write is
+ * acknowledged as soon as the CRC has been checked and the page has been copied
+ * into the temporary page buffer. Erasing and writing the page then proceeds
+ * while the next frame is being received, so that flash programming time is
+ * hidden behind the serial transfer. The host may send the next frame before
+ * the previous one has been acknowledged, except after the first frame, for
+ * which the bootloader may first have to erase page 0 without receiving.
+ *
+ * The first page write of an update erases page 0 unless it writes page 0
+ * itself. The update tool writes page 0 last, so that an interrupted update
+ * leaves no reset vector and the bootloader keeps waiting for a new image
+ * instead of starting a half-written application.
+ */
+
+#include <avr/io.h>
+#include <avr/boot.h>
+#include <avr/wdt.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include <util/delay.h>
+
+#ifndef BOOTLOADER_BAUD
+#define BOOTLOADER_BAUD 19200
+#endif
+
+namespace
+{
+	constexpr uint16_t bootStart = FLASHEND + 1 - 2048;
+	constexpr uint8_t pageSize = SPM_PAGESIZE;
+
+	/// number of 10us polls before a receive times out, about 1 second.
+	constexpr uint32_t receiveTimeout = 100000;
+
+	/// number of receive timeouts before an existing application is started
+	/// when no programmer has shown up.
+	constexpr uint8_t startTimeouts = 3;
+
+	/// precedes the hello and quit commands.
+	constexpr uint8_t syncWord[] = { 0xa5, 0x5a, 0x3c, 0xc3 };
+
+	enum Command : uint8_t
+	{
+		hello = 'H',
+		write = 'W',
+		quit  = 'Q'
+	};
+
+	enum Response : uint8_t
+	{
+		accepted   = 'K',
+		rejected   = 'E',
+		identifier = 'B'
+	};
+
+	enum class Flash : uint8_t
+	{
+		idle,
+		erasing,
+		writing
+	};
+
+	Flash flashState = Flash::idle;
+	uint16_t flashAddress;
+	uint8_t page[pageSize];
+
+	/// whether a page has been written since the bootloader started.
+	bool written = false;
+
+	/**
+	 * Advance the erase/write sequence of the page that is being programmed
+	 * without waiting for the flash.
+	 */
+	void ServiceFlash()
+	{
+		if (flashState == Flash::idle or boot_spm_busy()) return;
+
+		if (flashState == Flash::erasing)
+		{
+			boot_page_write( flashAddress);
+			flashState = Flash::writing;
+		}
+		else
+		{
+			flashState = Flash::idle;
+		}
+	}
+
+	void FinishFlash()
+	{
+		while (flashState != Flash::idle) ServiceFlash();
+	}
+
+	void InitUart()
+	{
+		constexpr uint16_t ubrr = (F_CPU / 8 + BOOTLOADER_BAUD / 2) / BOOTLOADER_BAUD - 1;
+		UBRR0 = ubrr;
+		UCSR0A = _BV( U2X0);
+		UCSR0B = _BV( RXEN0) | _BV( TXEN0);
+	}
+
+	void Send( uint8_t byte)
+	{
+		loop_until_bit_is_set( UCSR0A, UDRE0);
+		UDR0 = byte;
+	}
+
+	/**
+	 * Receive a byte, servicing the flash while waiting. Returns false
+	 * on a timeout.
+	 */
+	bool Receive( uint8_t &byte)
+	{
+		for (uint32_t polls = receiveTimeout; polls; --polls)
+		{
+			ServiceFlash();
+			if (bit_is_set( UCSR0A, RXC0))
+			{
+				byte = UDR0;
+				return true;
+			}
+			_delay_us( 10);
+		}
+		return false;
+	}
+
+	bool Receive( uint8_t &byte, uint16_t &crc)
+	{
+		if (not Receive( byte)) return false;
+		crc = _crc_xmodem_update( crc, byte);
+		return true;
+	}
+
+	/**
+	 * Check for a reset vector. After programming, the application section
+	 * reads as erased until it is enabled again, so finish any programming
+	 * and enable it first.
+	 */
+	bool ApplicationPresent()
+	{
+		FinishFlash();
+		boot_rww_enable();
+		return pgm_read_word( 0) != 0xffff;
+	}
+
+	void StartApplication()
+	{
+		FinishFlash();
+		boot_rww_enable();
+		loop_until_bit_is_set( UCSR0A, UDRE0);
+		_delay_ms( 2); // let the last byte leave the shift register.
+		UCSR0B = 0;
+		UCSR0A = 0;
+		reinterpret_cast<void (*)()>( 0)();
+	}
+
+	/**
+	 * Receive one page write frame and start programming it if
+	 * the frame is valid.
+	 */
+	Response ReceivePage()
+	{
+		uint16_t crc = 0;
+		uint8_t high;
+		uint8_t low;
+		if (not Receive( high, crc) or not Receive( low, crc)) return rejected;
+
+		for (auto &byte : page)
+		{
+			if (not Receive( byte, crc)) return rejected;
+		}
+
+		uint8_t crcHigh;
+		uint8_t crcLow;
+		if (not Receive( crcHigh) or not Receive( crcLow)) return rejected;
+
+		const uint16_t address = (high << 8) | low;
+		if (crc != ((crcHigh << 8) | crcLow)
+				or address % pageSize
+				or address >= bootStart)
+		{
+			return rejected;
+		}
+
+		// the previous page has normally finished programming while
+		// this frame was being received.
+		FinishFlash();
+
+		// remove the reset vector of the old application before
+		// overwriting any of it, see the protocol description.
+		if (not written and address != 0)
+		{
+			boot_page_erase( 0);
+			boot_spm_busy_wait();
+		}
+		written = true;
+
+		for (uint8_t offset = 0; offset < pageSize; offset += 2)
+		{
+			boot_page_fill( address + offset, page[offset] | (page[offset + 1] << 8));
+		}
+		boot_page_erase( address);
+		flashAddress = address;
+		flashState = Flash::erasing;
+		return accepted;
+	}
+}
+
+int main()
+{
+	const uint8_t resetFlags = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+
+	// The application requests an update by means of a watchdog reset,
+	// all other resets start the application immediately.
+	if (ApplicationPresent() and not (resetFlags & _BV( WDRF)))
+	{
+		StartApplication();
+	}
+
+	InitUart();
+
+	bool programming = false;
+	uint8_t timeouts = 0;
+	uint8_t synced = 0; // number of sync word bytes received
+	for (;;)
+	{
+		uint8_t command;
+		if (not Receive( command))
+		{
+			synced = 0;
+			if (not programming and ApplicationPresent() and ++timeouts >= startTimeouts)
+			{
+				StartApplication();
+			}
+			continue;
+		}
+
+		if (synced < sizeof syncWord)
+		{
+			if (command == syncWord[synced])
+			{
+				++synced;
+			}
+			else
+			{
+				synced = command == syncWord[0];
+				if (command == write and programming)
+				{
+					Send( ReceivePage());
+				}
+				// ignore anything else, such as SLIP frames from esp-link.
+			}
+			continue;
+		}
+
+		synced = 0;
+		if (command == hello)
+		{
+			programming = true;
+			Send( identifier);
+			Send( pageSize);
+		}
+		else if (command == quit)
+		{
+			if (ApplicationPresent())
+			{
+				Send( accepted);
+				StartApplication();
+			}
+			Send( rejected);
+		}
+	}
+}
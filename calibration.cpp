@@ -0,0 +1,177 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "calibration.h"
+#include "timer.h"
+#include "format.h"
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+namespace
+{
+	uint8_t EEMEM storedOsccal;
+
+	bool anchored = false;
+	uint32_t anchorReference;
+	uint32_t anchorTicks;
+
+	int32_t lastErrorppm = 0;
+	bool converged = false;
+
+	/// set by Disturb(), the current measurement can't be trusted.
+	bool disturbed = false;
+
+	/// outcome of a measurement: running fast, slow or within tolerance.
+	enum class Verdict : uint8_t
+	{
+		fast,
+		slow,
+		good
+	};
+	Verdict previousVerdict = Verdict::good;
+	uint8_t agreeing = 0;
+
+	/// whether the last measurement changed OSCCAL ("adj"), stored it ("ok")
+	/// or is waiting for more measurements to agree ("wait").
+	const char *status = "wait";
+
+	void Anchor( uint32_t milliseconds)
+	{
+		anchorReference = milliseconds;
+		anchorTicks = Timer::GetCurrentLong();
+		anchored = true;
+	}
+}
+
+namespace Calibration
+{
+	/**
+	 * Load a previously stored OSCCAL value, if there is one.
+	 */
+	void Load()
+	{
+		const uint8_t value = eeprom_read_byte( &storedOsccal);
+		if (value != 0xff)
+		{
+			OSCCAL = value;
+		}
+	}
+
+	/**
+	 * Process a reference time stamp. Returns true if a measurement was done,
+	 * in which case Format() will describe the result.
+	 */
+	bool Reference( uint32_t milliseconds)
+	{
+		if (disturbed)
+		{
+			// this time stamp may have been delayed as well, so don't even
+			// use it as the start of the next measurement.
+			disturbed = false;
+			anchored = false;
+			return false;
+		}
+
+		const uint32_t span = milliseconds - anchorReference;
+		if (not anchored or span > maximumSpan)
+		{
+			Anchor( milliseconds);
+			return false;
+		}
+
+		if (span < minimumSpan) return false;
+
+		// 7812.5 ticks per second is 125/16 ticks per millisecond.
+		const uint32_t expected = span * 125 / 16;
+		const int32_t difference = Timer::GetCurrentLong() - anchorTicks - expected;
+		lastErrorppm = difference * 1000 / static_cast<int32_t>( expected / 1000);
+
+		const uint8_t current = OSCCAL;
+		Verdict verdict = Verdict::good;
+		if (lastErrorppm > toleranceppm and (current & 0x7f) != 0)
+		{
+			verdict = Verdict::fast;
+		}
+		else if (lastErrorppm < -toleranceppm and (current & 0x7f) != 0x7f)
+		{
+			verdict = Verdict::slow;
+		}
+
+		agreeing = verdict == previousVerdict ? agreeing + 1 : 1;
+		previousVerdict = verdict;
+
+		converged = false;
+		status = "wait";
+		if (agreeing >= agreementsNeeded)
+		{
+			agreeing = 0;
+			if (verdict == Verdict::fast)
+			{
+				OSCCAL = current - 1;
+				status = "adj";
+			}
+			else if (verdict == Verdict::slow)
+			{
+				OSCCAL = current + 1;
+				status = "adj";
+			}
+			else
+			{
+				converged = true;
+				status = "ok";
+				eeprom_update_byte( &storedOsccal, current);
+			}
+		}
+
+		// start a new measurement at the (possibly) new frequency.
+		Anchor( milliseconds);
+		return true;
+	}
+
+	/**
+	 * Report that the main loop was blocked, for instance by a transmission,
+	 * so that reference time stamps may have been delayed.
+	 */
+	void Disturb()
+	{
+		disturbed = true;
+	}
+
+	/**
+	 * Return true if the last measurement confirmed that the oscillator is
+	 * within tolerance, in which case its OSCCAL value was stored.
+	 */
+	bool Converged()
+	{
+		return converged;
+	}
+
+	/**
+	 * Describe the last measurement: the OSCCAL value, the measured error in ppm
+	 * and whether the value was stored ("ok"), adjusted ("adj") or left alone
+	 * until more measurements agree ("wait").
+	 */
+	char *Format( char *buffer)
+	{
+		buffer = Format::Hex( static_cast<uint8_t>( OSCCAL), buffer);
+		*buffer++ = ' ';
+		if (lastErrorppm < 0)
+		{
+			*buffer++ = '-';
+			buffer = Format::Decimal( static_cast<uint32_t>( -lastErrorppm), buffer);
+		}
+		else
+		{
+			buffer = Format::Decimal( static_cast<uint32_t>( lastErrorppm), buffer);
+		}
+		*buffer++ = ' ';
+		for (const char *text = status; *text; ++text) *buffer++ = *text;
+		*buffer = 0;
+		return buffer;
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * calibration.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef CALIBRATION_H_
+#define CALIBRATION_H_
+#include <stdint.h>
+
+/**
+ * Calibration of the internal RC oscillator against an external time reference.
+ *
+ * A controller periodically publishes its own clock, in milliseconds, on
+ * spider/calibrate. Only differences between reference values are used, so the
+ * reference may wrap at 2^32 ms. Once the reference values span at least
+ * minimumSpan milliseconds, the number of timer ticks that passed locally is
+ * compared with the number of ticks that should have passed. Only when
+ * agreementsNeeded consecutive measurements agree, OSCCAL is moved one step in
+ * the right direction or, when the error is within half a step, the OSCCAL
+ * value is stored in EEPROM and loaded at every startup.
+ *
+ * A transmission blocks the main loop for up to about 1.3 seconds, which would
+ * delay the reference and make a single measurement several times less accurate
+ * than the tolerance. Disturb() must therefore be called whenever that happens;
+ * the measurement in progress is then discarded.
+ */
+namespace Calibration
+{
+	void Load();
+	bool Reference( uint32_t milliseconds);
+	void Disturb();
+	bool Converged();
+	char *Format( char *buffer);
+
+	/// shortest reference interval that is used for a measurement.
+	constexpr uint32_t minimumSpan = 60000;
+
+	/// reference intervals longer than this are considered stale.
+	constexpr uint32_t maximumSpan = 600000;
+
+	/// half of the typical frequency change of one OSCCAL step, in ppm.
+	constexpr int32_t toleranceppm = 3500;
+
+	/// number of consecutive measurements that must agree before OSCCAL
+	/// is changed or stored.
+	constexpr uint8_t agreementsNeeded = 3;
+
+	constexpr uint8_t formatSize = 2 + 1 + 11 + 1 + 4 + 1;
+}
+
+#endif /* CALIBRATION_H_ */
@@ -0,0 +1,114 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "clock.h"
+#include "timer.h"
+
+namespace
+{
+	bool synchronized = false;
+
+	/// local timer value and server time at the last synchronization.
+	uint32_t referenceTicks;
+	uint32_t referenceTime;
+
+	/// estimated drift of the local clock, in ppm. Positive values
+	/// mean that the local clock is slow.
+	int32_t drift = 0;
+
+	/// shortest round trip seen, in timer ticks.
+	uint32_t bestRoundTrip = 0xffffffff;
+
+	/// samples with a round trip longer than this factor times the best one
+	/// are considered too noisy.
+	constexpr uint8_t roundTripTolerance = 2;
+
+	/// samples more than this many milliseconds away from the prediction reset
+	/// the drift estimate instead of adjusting it.
+	constexpr int32_t maximumError = 1000;
+
+	/**
+	 * Server time at the given local timer value.
+	 */
+	uint32_t ServerTime( uint32_t ticks)
+	{
+		const uint32_t elapsed = Clock::TicksToMilliseconds( ticks - referenceTicks);
+		const int32_t correction = static_cast<int32_t>( elapsed / 1000) * drift / 1000;
+		return referenceTime + elapsed + correction;
+	}
+}
+
+namespace Clock
+{
+	/**
+	 * Convert timer ticks of 128us to milliseconds without overflowing.
+	 */
+	uint32_t TicksToMilliseconds( uint32_t ticks)
+	{
+		// 1 tick is 16/125 ms
+		return ticks / 125 * 16 + ticks % 125 * 16 / 125;
+	}
+
+	/**
+	 * Process an answer of the time server. sent is the timer value that was
+	 * published in the request. Returns false if the sample was rejected.
+	 */
+	bool Sample( uint32_t sent, uint32_t serverTime)
+	{
+		const uint32_t now = Timer::GetCurrentLong();
+		const uint32_t roundTrip = now - sent;
+		if (roundTrip / roundTripTolerance > bestRoundTrip)
+		{
+			// let the best round trip age, in case the network got slower.
+			bestRoundTrip += bestRoundTrip / 4 + 1;
+			return false;
+		}
+		if (roundTrip < bestRoundTrip) bestRoundTrip = roundTrip;
+
+		const uint32_t middle = sent + roundTrip / 2;
+		if (synchronized)
+		{
+			const uint32_t elapsed = TicksToMilliseconds( middle - referenceTicks) / 1000;
+			const int32_t error = serverTime - ServerTime( middle);
+			if (error > maximumError or error < -maximumError)
+			{
+				drift = 0;
+			}
+			else if (elapsed)
+			{
+				// move a quarter of the way towards the measured drift.
+				drift += error * 1000 / static_cast<int32_t>( elapsed) / 4;
+			}
+		}
+
+		referenceTicks = middle;
+		referenceTime = serverTime;
+		synchronized = true;
+		return true;
+	}
+
+	bool Synchronized()
+	{
+		return synchronized;
+	}
+
+	/**
+	 * Return the current server time in milliseconds, or the local uptime in
+	 * milliseconds if the clock was never synchronized.
+	 */
+	uint32_t Now()
+	{
+		const uint32_t ticks = Timer::GetCurrentLong();
+		return synchronized ? ServerTime( ticks) : TicksToMilliseconds( ticks);
+	}
+
+	int32_t Drift()
+	{
+		return drift;
+	}
+}
@@ -0,0 +1,38 @@
+/*
+ * clock.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+#include <stdint.h>
+
+/**
+ * Wall clock, synchronized over MQTT.
+ *
+ * The node publishes its 32-bit timer value on spider/time/request. A time
+ * server (tools/time_server.py) answers on spider/time with that same value
+ * and its own clock in milliseconds, modulo 2^32. Like in NTP, the server time
+ * is assumed to belong to the middle of the round trip.
+ *
+ * Each answer sets the clock offset. The difference between the predicted and
+ * the received server time is used to estimate the drift of the local
+ * oscillator, which is applied between synchronizations. Answers with a round trip
+ * time much larger than the best one seen are ignored.
+ *
+ * Times are in milliseconds modulo 2^32. Receivers reconstruct the full time by
+ * choosing the value closest to their own clock.
+ */
+namespace Clock
+{
+	bool Sample( uint32_t sent, uint32_t serverTime);
+	bool Synchronized();
+	uint32_t Now();
+	int32_t Drift();
+
+	uint32_t TicksToMilliseconds( uint32_t ticks);
+}
+
+#endif /* CLOCK_H_ */
@@ -0,0 +1,129 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "compensation.h"
+#include "format.h"
+#include <avr/eeprom.h>
+
+namespace
+{
+	uint16_t EEMEM storedReference;
+
+	/// temperatures are ADC values with 12 bits of resolution against the
+	/// 1.1V reference, about four per degree Celsius.
+	constexpr uint16_t unitsPerDegree = 4;
+
+	/// the value in storedReference, 0xffff if there is none.
+	uint16_t stored = 0xffff;
+
+	/// how far the reference may move before it is written to EEPROM again.
+	/// Calibration converges every minute while it runs and ADC noise changes
+	/// the temperature nearly every time, which would wear out the EEPROM.
+	constexpr uint16_t storeTolerance = unitsPerDegree;
+
+	/// 0 if no temperature has been measured yet.
+	uint16_t temperature = 0;
+
+	/// 0 if there is no reference temperature yet.
+	uint16_t reference = 0;
+
+	/// duration correction in units of 2^-16.
+	int16_t correction = 0;
+
+	/// correction in units of 2^-16 is ppm * 65536 / 10^6, about ppm / 15.26.
+	constexpr int32_t ppmPerCorrectionUnit100 = 1526;
+}
+
+namespace Compensation
+{
+	/**
+	 * Load the reference temperature of the last oscillator calibration.
+	 */
+	void Load()
+	{
+		stored = eeprom_read_word( &storedReference);
+		if (stored != 0xffff)
+		{
+			reference = stored;
+		}
+	}
+
+	/**
+	 * Process a new temperature reading and recalculate the correction.
+	 */
+	void Update( uint16_t newTemperature)
+	{
+		temperature = newTemperature;
+		if (not reference) reference = temperature;
+
+		const int32_t difference = static_cast<int32_t>( temperature) - reference;
+		correction = difference * ppmPerDegree * 100 / unitsPerDegree / ppmPerCorrectionUnit100;
+	}
+
+	/**
+	 * Make the current temperature the reference. To be called when the
+	 * oscillator has been calibrated.
+	 *
+	 * The reference is only written to EEPROM if it differs from the stored
+	 * one by more than storeTolerance.
+	 */
+	void StoreReference()
+	{
+		if (not temperature) return;
+
+		reference = temperature;
+		correction = 0;
+
+		const uint16_t difference = reference > stored ? reference - stored : stored - reference;
+		if (difference > storeTolerance)
+		{
+			eeprom_update_word( &storedReference, reference);
+			stored = reference;
+		}
+	}
+
+	/**
+	 * Correct a duration in units of 4us for the current oscillator frequency.
+	 */
+	uint16_t Scale( uint16_t us4)
+	{
+		return us4 + (static_cast<int32_t>( us4) * correction >> 16);
+	}
+
+	uint32_t Scale( uint32_t us4)
+	{
+		const int32_t high = us4 >> 16;
+		const int32_t low = static_cast<uint16_t>( us4);
+		return us4 + high * correction + (low * correction >> 16);
+	}
+
+	uint16_t Temperature()
+	{
+		return temperature;
+	}
+
+	int16_t Correctionppm()
+	{
+		return static_cast<int32_t>( correction) * ppmPerCorrectionUnit100 / 100;
+	}
+
+	/**
+	 * Write the current and the reference temperature in ADC units and the
+	 * correction in ppm.
+	 */
+	char *Format( char *buffer)
+	{
+		buffer = Format::Decimal( temperature, buffer);
+		*buffer++ = ' ';
+		buffer = Format::Decimal( reference, buffer);
+		*buffer++ = ' ';
+		const int16_t ppm = Correctionppm();
+		if (ppm < 0) *buffer++ = '-';
+		return Format::Decimal( static_cast<uint16_t>( ppm < 0 ? -ppm : ppm), buffer);
+	}
+}
@@ -0,0 +1,45 @@
+/*
+ * compensation.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef COMPENSATION_H_
+#define COMPENSATION_H_
+#include <stdint.h>
+
+/**
+ * Temperature compensation of pulse timing.
+ *
+ * The frequency of the internal RC oscillator rises with temperature, which
+ * makes every pulse and gap that is timed in clock cycles shorter. The internal
+ * temperature sensor is read by the background ADC sampler (see analog.h) and
+ * the difference with a reference temperature is turned into a correction
+ * that Scale() applies to pulse durations.
+ *
+ * The reference temperature is the one at which the oscillator was last
+ * calibrated (see calibration.h) or, on an uncalibrated node, the temperature
+ * at startup.
+ */
+namespace Compensation
+{
+	void Load();
+	void Update( uint16_t temperature);
+	void StoreReference();
+
+	uint16_t Scale( uint16_t us4);
+	uint32_t Scale( uint32_t us4);
+
+	uint16_t Temperature();
+	int16_t Correctionppm();
+	char *Format( char *buffer);
+
+	/// frequency change of the 8MHz RC oscillator per degree Celsius,
+	/// from the typical characteristics in the datasheet.
+	constexpr int16_t ppmPerDegree = 200;
+
+	constexpr uint8_t formatSize = 2 * 6 + 7;
+}
+
+#endif /* COMPENSATION_H_ */
@@ -0,0 +1,111 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "format.h"
+#include <avr/pgmspace.h>
+
+namespace
+{
+	const uint8_t powers8[] PROGMEM = { 100, 10};
+	const uint16_t powers16[] PROGMEM = { 10000, 1000, 100, 10};
+	const uint32_t powers32[] PROGMEM = {
+			1000000000, 100000000, 10000000, 1000000, 100000,
+			10000, 1000, 100, 10
+	};
+
+	uint8_t ReadPower( const uint8_t *power)
+	{
+		return pgm_read_byte( power);
+	}
+
+	uint16_t ReadPower( const uint16_t *power)
+	{
+		return pgm_read_word( power);
+	}
+
+	uint32_t ReadPower( const uint32_t *power)
+	{
+		return pgm_read_dword( power);
+	}
+
+	char HexDigit( uint8_t nibble)
+	{
+		return nibble < 10 ? '0' + nibble : 'A' - 10 + nibble;
+	}
+
+	/**
+	 * Emit the decimal digits of value by repeatedly subtracting powers of ten,
+	 * which is much cheaper on an AVR than a software division.
+	 *
+	 * The last digit is whatever remains after subtracting all powers, so
+	 * the table does not contain the power 1.
+	 */
+	template<typename T, size_t count>
+	char *DecimalDigits( T value, char *buffer, const T (&powers)[count])
+	{
+		bool leading = true;
+		for (const T *power = powers; power != powers + count; ++power)
+		{
+			const T current = ReadPower( power);
+			char digit = '0';
+			while (value >= current)
+			{
+				value -= current;
+				++digit;
+			}
+
+			if (digit != '0' or not leading)
+			{
+				*buffer++ = digit;
+				leading = false;
+			}
+		}
+
+		*buffer++ = '0' + static_cast<char>( value);
+		*buffer = 0;
+		return buffer;
+	}
+}
+
+namespace Format
+{
+	char *Hex( uint8_t value, char *buffer)
+	{
+		*buffer++ = HexDigit( value >> 4);
+		*buffer++ = HexDigit( value & 0x0f);
+		*buffer = 0;
+		return buffer;
+	}
+
+	char *Hex( uint16_t value, char *buffer)
+	{
+		buffer = Hex( static_cast<uint8_t>( value >> 8), buffer);
+		return Hex( static_cast<uint8_t>( value), buffer);
+	}
+
+	char *Hex( uint32_t value, char *buffer)
+	{
+		buffer = Hex( static_cast<uint16_t>( value >> 16), buffer);
+		return Hex( static_cast<uint16_t>( value), buffer);
+	}
+
+	char *Decimal( uint8_t value, char *buffer)
+	{
+		return DecimalDigits( value, buffer, powers8);
+	}
+
+	char *Decimal( uint16_t value, char *buffer)
+	{
+		return DecimalDigits( value, buffer, powers16);
+	}
+
+	char *Decimal( uint32_t value, char *buffer)
+	{
+		return DecimalDigits( value, buffer, powers32);
+	}
+}
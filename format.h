@@ -0,0 +1,42 @@
+/*
+ * format.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+#include <stdint.h>
+
+/**
+ * Reentrant, division-free conversion of unsigned integers to text.
+ *
+ * All functions write a zero-terminated string into a caller-supplied buffer and
+ * return a pointer to the terminating zero, so that several conversions can be
+ * chained into a single buffer.
+ *
+ * Hexadecimal output always has a fixed width (2, 4 or 8 upper case digits),
+ * decimal output has no leading zeros.
+ */
+namespace Format
+{
+	char *Hex( uint8_t value, char *buffer);
+	char *Hex( uint16_t value, char *buffer);
+	char *Hex( uint32_t value, char *buffer);
+
+	char *Decimal( uint8_t value, char *buffer);
+	char *Decimal( uint16_t value, char *buffer);
+	char *Decimal( uint32_t value, char *buffer);
+
+	/// buffer sizes, including the terminating zero, needed for the
+	/// conversion of a value of the given size.
+	constexpr uint8_t hexSize8 = 3;
+	constexpr uint8_t hexSize16 = 5;
+	constexpr uint8_t hexSize32 = 9;
+	constexpr uint8_t decimalSize8 = 4;
+	constexpr uint8_t decimalSize16 = 6;
+	constexpr uint8_t decimalSize32 = 11;
+}
+
+#endif /* FORMAT_H_ */
@@ -0,0 +1,126 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "history.h"
+#include "clock.h"
+#include "telemetry.h"
+
+namespace
+{
+	struct Entry
+	{
+		uint32_t time;
+		uint8_t source;
+		uint8_t switchIndex;
+		uint8_t action;
+		History::Status status;
+		uint8_t repeats;
+		uint16_t latency;
+	};
+
+	static_assert( History::capacity and not (History::capacity & (History::capacity - 1)), "history capacity must be a power of two");
+
+	Entry entries[History::capacity];
+
+	/// number of entries ever added, the newest entry is at next - 1.
+	uint8_t next = 0;
+
+	/// number of valid entries.
+	uint8_t stored = 0;
+
+	/**
+	 * Return the entry for a handle, or nullptr if it has been overwritten.
+	 */
+	Entry *Find( uint8_t handle)
+	{
+		if (static_cast<uint8_t>( next - handle - 1) >= History::capacity) return nullptr;
+		return &entries[handle & (History::capacity - 1)];
+	}
+
+	uint8_t *Put( uint8_t *output, uint32_t value, uint8_t size)
+	{
+		for (; size; --size)
+		{
+			*output++ = value;
+			value >>= 8;
+		}
+		return output;
+	}
+}
+
+namespace History
+{
+	/**
+	 * Return an 8-bit hash of the given text, to identify the topic on
+	 * which a command arrived.
+	 */
+	uint8_t Hash( const char *text, uint8_t length)
+	{
+		uint8_t hash = 0;
+		for (; length; --length)
+		{
+			hash = 31 * hash + static_cast<uint8_t>( *text++);
+		}
+		return hash;
+	}
+
+	/**
+	 * Record a command, overwriting the oldest entry if the history is full.
+	 * Returns a handle with which the entry can be updated later.
+	 */
+	uint8_t Add( uint8_t source, uint8_t switchIndex, uint8_t action, Status status)
+	{
+		entries[next & (capacity - 1)] = Entry{ Clock::Now(), source, switchIndex, action, status, 0, 0};
+		if (stored < capacity) ++stored;
+		return next++;
+	}
+
+	void Dropped( uint8_t handle)
+	{
+		if (Entry *entry = Find( handle)) entry->status = dropped;
+	}
+
+	/**
+	 * Record the transmission of a command: how often it was sent and how
+	 * long it had to wait for the transmitter.
+	 */
+	void Sent( uint8_t handle, uint8_t repeats, uint16_t latency)
+	{
+		if (Entry *entry = Find( handle))
+		{
+			entry->status = sent;
+			entry->repeats = repeats;
+			entry->latency = latency;
+		}
+	}
+
+	/**
+	 * Write the history as a stuffed, zero-terminated batch into buffer, which
+	 * must be able to hold maxFrameSize bytes. Returns the length of the batch.
+	 */
+	uint8_t Encode( char *buffer)
+	{
+		uint8_t raw[maxRawSize];
+		uint8_t *output = raw;
+		*output++ = stored;
+		output = Put( output, Clock::Now(), 4);
+		for (uint8_t handle = next - stored; handle != next; ++handle)
+		{
+			const Entry &entry = entries[handle & (capacity - 1)];
+			output = Put( output, entry.time, 4);
+			*output++ = entry.source;
+			*output++ = entry.switchIndex;
+			*output++ = entry.action;
+			*output++ = entry.status;
+			*output++ = entry.repeats;
+			output = Put( output, entry.latency, 2);
+		}
+
+		return Telemetry::Stuff( raw, output - raw, buffer);
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ * history.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef HISTORY_H_
+#define HISTORY_H_
+#include <stdint.h>
+
+/**
+ * History of the most recent switch commands.
+ *
+ * Every switch command that arrives over MQTT is recorded, whether it was
+ * rejected or queued, and the entry is updated once the command has been
+ * transmitted. Both operations take constant time. Encode() dumps the history
+ * as a COBS-stuffed binary batch, which tools/telemetry_decoder.py --history
+ * decodes.
+ *
+ * Batch layout before stuffing, all numbers little-endian:
+ *     entry count (1 byte), Clock::Now() at the time of the dump (4 bytes),
+ *     entries from oldest to newest (entrySize bytes each):
+ *         Clock::Now() at reception (4 bytes), topic hash (1 byte),
+ *         switch (1 byte), action (1 byte), Status (1 byte),
+ *         repeats sent (1 byte), latency in timer ticks (2 bytes)
+ *
+ * Switch and action are 0xff when they could not be parsed.
+ */
+namespace History
+{
+	enum Status : uint8_t
+	{
+		queued,   ///< waiting for transmission
+		sent,     ///< transmitted
+		invalid,  ///< rejected because the topic or message was malformed
+		dropped   ///< rejected because the command queue was full
+	};
+
+	uint8_t Hash( const char *text, uint8_t length);
+	uint8_t Add( uint8_t source, uint8_t switchIndex, uint8_t action, Status status);
+	void Dropped( uint8_t handle);
+	void Sent( uint8_t handle, uint8_t repeats, uint16_t latency);
+
+	uint8_t Encode( char *buffer);
+
+	constexpr uint8_t unknown = 0xff;
+	constexpr uint8_t capacity = 8;
+	constexpr uint8_t entrySize = 11;
+	constexpr uint8_t maxRawSize = 5 + capacity * entrySize;
+	constexpr uint8_t maxFrameSize = maxRawSize + maxRawSize / 254 + 2;
+}
+
+#endif /* HISTORY_H_ */
@@ -0,0 +1,122 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "memory.h"
+#include "format.h"
+#include <avr/io.h>
+
+extern "C"
+{
+	// provided by the linker: end of .data and .bss, and top of the stack.
+	extern uint8_t _end;
+	extern uint8_t __stack;
+}
+
+/**
+ * Paint the unused SRAM with the canary value.
+ *
+ * This runs in .init1, before the stack pointer and the zero register are set up,
+ * so it must not use either of them.
+ */
+void PaintStack() __attribute__ ((naked, used, section( ".init1")));
+void PaintStack()
+{
+	asm volatile(
+			"    ldi r30, lo8(_end)      \n"
+			"    ldi r31, hi8(_end)      \n"
+			"    ldi r24, %[canary]      \n"
+			"    ldi r25, hi8(__stack)   \n"
+			"    rjmp 2f                 \n"
+			"1:  st Z+, r24              \n"
+			"2:  cpi r30, lo8(__stack)   \n"
+			"    cpc r31, r25            \n"
+			"    brlo 1b                 \n"
+			"    breq 1b                 \n"
+			:
+			: [canary] "M" (Memory::canary)
+	);
+}
+
+namespace
+{
+	/// next byte to inspect.
+	const uint8_t *scan = &_end;
+
+	/// lowest byte found to be overwritten, anything below is still unused.
+	const uint8_t *lowest = &__stack;
+}
+
+namespace Memory
+{
+	/**
+	 * Inspect the next few bytes of the painted area.
+	 *
+	 * When a byte is found that was overwritten, it is the new high-water mark if it
+	 * is lower than the previous one and the scan starts again from the bottom.
+	 */
+	void Step()
+	{
+		for (uint8_t count = bytesPerStep; count; --count)
+		{
+			if (scan >= lowest or *scan != canary)
+			{
+				if (scan < lowest) lowest = scan;
+				scan = &_end;
+				return;
+			}
+			++scan;
+		}
+	}
+
+	/**
+	 * Size of .data and .bss.
+	 */
+	uint16_t StaticSize()
+	{
+		return &_end - reinterpret_cast<const uint8_t *>( RAMSTART);
+	}
+
+	/**
+	 * Largest stack size seen so far.
+	 */
+	uint16_t StackMaximum()
+	{
+		return &__stack + 1 - lowest;
+	}
+
+	/**
+	 * Number of bytes that have never been used.
+	 */
+	uint16_t Unused()
+	{
+		return lowest - &_end;
+	}
+
+	/**
+	 * Number of bytes between the static data and the current stack pointer.
+	 */
+	uint16_t FreeNow()
+	{
+		return reinterpret_cast<const uint8_t *>( SP) - &_end;
+	}
+
+	/**
+	 * Write the static size, maximum stack size, never used and currently
+	 * free SRAM, in bytes.
+	 */
+	char *Format( char *buffer)
+	{
+		buffer = Format::Decimal( StaticSize(), buffer);
+		*buffer++ = ' ';
+		buffer = Format::Decimal( StackMaximum(), buffer);
+		*buffer++ = ' ';
+		buffer = Format::Decimal( Unused(), buffer);
+		*buffer++ = ' ';
+		return Format::Decimal( FreeNow(), buffer);
+	}
+}
@@ -0,0 +1,38 @@
+/*
+ * memory.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef MEMORY_H_
+#define MEMORY_H_
+#include <stdint.h>
+
+/**
+ * Stack high-water mark measurement.
+ *
+ * At startup, before any other initialization, all SRAM between the end of the
+ * static data and the top of the stack is painted with a canary value. Step()
+ * scans a few bytes of that region each time it is called, looking for the lowest
+ * byte that doesn't hold the canary anymore, which is the deepest point the stack
+ * has reached.
+ *
+ * This firmware doesn't use the heap. If it did, heap allocations would show up
+ * as stack usage.
+ */
+namespace Memory
+{
+	void Step();
+	uint16_t StaticSize();
+	uint16_t StackMaximum();
+	uint16_t Unused();
+	uint16_t FreeNow();
+	char *Format( char *buffer);
+
+	constexpr uint8_t canary = 0xc5;
+	constexpr uint8_t bytesPerStep = 8;
+	constexpr uint8_t formatSize = 4 * 6;
+}
+
+#endif /* MEMORY_H_ */
@@ -0,0 +1,94 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "occupancy.h"
+#include "timer.h"
+
+namespace
+{
+	bool occupied = false;
+
+	/// current PIR output.
+	bool active = false;
+
+	/// Timer::GetCurrentLong() value of the last PIR transition.
+	uint32_t lastMotion = 0;
+
+	/// start of the current occupied period, or of the current report period
+	/// if it started later.
+	uint32_t occupiedSince = 0;
+
+	/// occupied time in the current report period, not including the
+	/// ongoing occupied period.
+	uint32_t occupiedTicks = 0;
+
+	uint32_t timeout = static_cast<uint32_t>( Occupancy::defaultTimeout) * Timer::ticksPerSecond;
+}
+
+namespace Occupancy
+{
+	/**
+	 * Register a PIR transition. Returns true if this made the area occupied.
+	 */
+	bool Motion( bool newActive)
+	{
+		const uint32_t now = Timer::GetCurrentLong();
+		active = newActive;
+		lastMotion = now;
+		if (active and not occupied)
+		{
+			occupied = true;
+			occupiedSince = now;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Check whether the vacancy timeout has passed since the last motion.
+	 * Returns true if this made the area vacant.
+	 */
+	bool Expired()
+	{
+		const uint32_t now = Timer::GetCurrentLong();
+		if (not occupied or active or now - lastMotion < timeout) return false;
+
+		occupied = false;
+		occupiedTicks += now - occupiedSince;
+		return true;
+	}
+
+	bool Occupied()
+	{
+		return occupied;
+	}
+
+	/**
+	 * Return the time spent occupied since the previous call, in timer ticks.
+	 */
+	uint32_t TakeOccupiedTicks()
+	{
+		const uint32_t now = Timer::GetCurrentLong();
+		uint32_t result = occupiedTicks;
+		if (occupied)
+		{
+			result += now - occupiedSince;
+			occupiedSince = now;
+		}
+		occupiedTicks = 0;
+		return result;
+	}
+
+	/**
+	 * Set the time without motion after which the area becomes vacant.
+	 */
+	void SetTimeout( uint16_t seconds)
+	{
+		timeout = static_cast<uint32_t>( seconds) * Timer::ticksPerSecond;
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * occupancy.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef OCCUPANCY_H_
+#define OCCUPANCY_H_
+#include <stdint.h>
+
+/**
+ * Occupancy tracking based on PIR transitions.
+ *
+ * The area becomes occupied on the first motion and vacant once the PIR has
+ * been inactive for the vacancy timeout. Only these state changes are worth
+ * publishing, the individual PIR transitions are not.
+ *
+ * The time spent occupied is accumulated in timer ticks of 128us (see
+ * Timer::GetCurrentLong()) and can be collected periodically with
+ * TakeOccupiedTicks().
+ */
+namespace Occupancy
+{
+	bool Motion( bool active);
+	bool Expired();
+	bool Occupied();
+	uint32_t TakeOccupiedTicks();
+
+	void SetTimeout( uint16_t seconds);
+
+	constexpr uint16_t defaultTimeout = 120;
+}
+
+#endif /* OCCUPANCY_H_ */
@@ -0,0 +1,60 @@
+/*
+ * queue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+#include <stdint.h>
+
+/**
+ * Fixed-size FIFO queue.
+ *
+ * The capacity must be a power of two, so that positions wrap by masking. The
+ * queue is not interrupt safe; it is meant to pass work from MQTT callbacks to
+ * the main loop.
+ */
+template<typename T, uint8_t capacity>
+class Queue
+{
+public:
+	static_assert( capacity and not (capacity & (capacity - 1)), "queue capacity must be a power of two");
+
+	bool Empty() const { return head == tail; }
+	bool Full() const { return static_cast<uint8_t>( head - tail) == capacity; }
+	uint8_t Size() const { return head - tail; }
+
+	/// oldest element, only valid if the queue is not empty.
+	const T &Front() const { return elements[tail & (capacity - 1)]; }
+
+	/**
+	 * Add an element at the end of the queue. Returns false if the queue
+	 * was full, in which case the element is dropped.
+	 */
+	bool Push( const T &value)
+	{
+		if (Full()) return false;
+		elements[head++ & (capacity - 1)] = value;
+		return true;
+	}
+
+	/**
+	 * Remove the element at the front of the queue. Returns false if the
+	 * queue was empty.
+	 */
+	bool Pop( T &value)
+	{
+		if (Empty()) return false;
+		value = elements[tail++ & (capacity - 1)];
+		return true;
+	}
+
+private:
+	T elements[capacity];
+	uint8_t head = 0;
+	uint8_t tail = 0;
+};
+
+#endif /* QUEUE_H_ */
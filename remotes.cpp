@@ -6,9 +6,23 @@
 //  http://www.boost.org/LICENSE_1_0.txt)
 //
 #include "timer.h"
+#include "format.h"
+#include "telemetry.h"
+#include "statistics.h"
+#include "calibration.h"
+#include "spi_output.h"
+#include "queue.h"
+#include "requests.h"
+#include "clock.h"
+#include "memory.h"
+#include "occupancy.h"
+#include "analog.h"
+#include "compensation.h"
+#include "history.h"
 #include <avr/interrupt.h>
 #include <util/delay.h>
 #include <avr/pgmspace.h>
+#include <avr/wdt.h>
 
 #include <avr_utilities/pin_definitions.hpp>
 #include <avr_utilities/devices/uart.h>
@@ -19,12 +33,83 @@
 
 namespace {
 PIN_TYPE( B, 6) led;
+#ifdef RF_OUTPUT_SPI
+// the transmitter is driven by the SPI peripheral, see spi_output.h
+PIN_TYPE( B, 3) transmit;
+PIN_TYPE( D, 3) pir;
+#else
 PIN_TYPE( D, 3) transmit;
 PIN_TYPE( B, 3) pir;
+#endif
 
 
 
 Timer::TimerWaitValue motionTimeout = Timer::always;
+Timer::TimerWaitValue telemetryTimeout = Timer::always;
+constexpr uint16_t telemetryInterval = 5 * Timer::ticksPerSecond;
+
+/// main loop iteration times, in units of 4us.
+Statistics loopStatistics;
+
+bool bootloaderRequested = false;
+
+/// work that publishes messages is not done in the esp-link callbacks, which
+/// may run during an inter-repeat gap, but in the main loop by publish_deferred().
+bool subscriptionsRequested = false;
+bool calibrationReportRequested = false;
+
+/// reports requested on spider/debug/, see debug_request().
+enum DebugReport : uint16_t
+{
+    loopReport          = 0x001,
+    deadTimeReport      = 0x002,
+    rttReport           = 0x004,
+    linkReport          = 0x008,
+    overrunReport       = 0x010,
+    lightReport         = 0x020,
+    compensationReport  = 0x040,
+    historyReport       = 0x080,
+    memoryReport        = 0x100
+};
+uint16_t debugReports = 0;
+uint16_t debugResets = 0;
+
+/// state of the connection with esp-link, see monitor_link().
+bool linked = false;
+bool mqttConnected = false;
+Timer::TimerWaitValue syncTimeout = Timer::always;
+uint16_t syncBackoff;
+constexpr uint16_t minimumSyncBackoff = Timer::ticksPerSecond / 4;
+constexpr uint16_t maximumSyncBackoff = 8 * Timer::ticksPerSecond;
+constexpr uint16_t linkTimeout = 5 * Timer::ticksPerSecond;
+
+/// time in timer ticks between a publish and esp-link reporting it as sent.
+Statistics linkStatistics;
+
+/// MQTT round trip time in timer ticks, measured with probe messages.
+Statistics rttStatistics;
+Timer::TimerWaitValue probeTimeout = Timer::always;
+constexpr uint16_t probeInterval = 8 * Timer::ticksPerSecond;
+
+/// set when a switch command arrives, probes are skipped while commands
+/// are coming in.
+bool commandsSinceProbe = false;
+
+/// Timer::GetCurrentLong() value at which to publish the next occupancy report.
+uint32_t nextOccupancyReport = 0;
+constexpr uint32_t occupancyReportInterval = 60UL * Timer::ticksPerSecond;
+
+/// Timer::GetCurrentLong() value at which to send the next time request.
+uint32_t nextTimeRequest = 0;
+constexpr uint32_t timeRequestInterval = 64UL * Timer::ticksPerSecond;
+
+/// time in units of 4us between the moment a command could have been
+/// transmitted and the moment it was.
+Statistics deadTimeStatistics;
+
+/// how many 4us units inter-repeat gaps overran their deadline because
+/// esp-link frames were being processed.
+Statistics overrunStatistics;
 esp_link::client::uart_type uart(19200);
 esp_link::client esp( uart);
 }
@@ -49,7 +134,7 @@ struct Encoding
 {
     /// how long to wait between sending the same signal again in units of
     /// 4 microseconds.
-    uint16_t us4_between_repeats;
+    uint32_t us4_between_repeats;
 
     /// how many bits in one transmission
     uint8_t bits;
@@ -59,10 +144,10 @@ struct Encoding
     /// us4_start_low is zero, the signal will go up and all
     /// subsequent pulses will be low-active
     /// If us4_start_low is non-zero and
-    uint16_t us4_start_high;
+    uint32_t us4_start_high;
 
     /// how long to stay low before starting a pulse train.
-    uint16_t us4_start_low;
+    uint32_t us4_start_low;
 
     /// describes a single symbol, usually a 1 or a 0
     typedef uint16_t Symbol[2];
@@ -77,7 +162,7 @@ constexpr int impuls = 1;
 constexpr int globaltronic = 2;
 
 // describe the known protocols
-const Encoding symbols[] = {
+constexpr Encoding symbols[] = {
     // quigg
     { 17000,    20,     175, 0, { { 175, 350 }, { 350, 175 } } },
 
@@ -159,91 +244,277 @@ void delay_4us(uint16_t delay)
     delay *= 2;
     static_assert( F_CPU == 8000000, "This code assumes a 8 Mhz clock");
     asm volatile(
-            "loop:          SBIW %[counter], 1 \n"
+            "1:             SBIW %[counter], 1 \n"
             "               RJMP .-0           \n"
             "               RJMP .-0           \n"
             "               RJMP .-0           \n"
             "               RJMP .-0           \n"
             "               RJMP .-0           \n"
             "               RJMP .-0           \n"
-            "               BRNE loop           \n"
-            :
-            : [counter] "w" (delay)
+            "               BRNE 1b            \n"
+            : [counter] "+w" (delay)
     );
 }
 
+/**
+ * Output primitives of the transmit kernels: drive the transmitter high, low
+ * or to the opposite level and keep it there for the given time in units of 4us.
+ *
+ * These either change the transmit pin and wait or, when RF_OUTPUT_SPI
+ * is defined, render the waveform into the SPI bitstream. The preamble levels
+ * can be long and are timed with the fine timer, symbols are short and use the
+ * delay loop. The fine timer's overflow interrupt would stretch the delay loop,
+ * so it is paused between begin_symbols() and end_symbols().
+ */
+#ifdef RF_OUTPUT_SPI
+void begin_transmission()           { SpiOutput::Start(); }
+void end_transmission()             { SpiOutput::Finish(); }
+void begin_symbols()                {}
+void end_symbols()                  {}
+void transmit_high( uint32_t us4)   { SpiOutput::High( us4); }
+void transmit_low( uint32_t us4)    { SpiOutput::Low( us4); }
+void transmit_toggle( uint16_t us4) { SpiOutput::Toggle( us4); }
+#else
+void begin_transmission()           {}
+void end_transmission()             { clear( transmit); }
+void begin_symbols()                { Timer::Fine::Pause(); }
+void end_symbols()                  { Timer::Fine::Resume(); }
+void transmit_high( uint32_t us4)   { set( transmit); Timer::Fine::Wait( us4); }
+void transmit_low( uint32_t us4)    { clear( transmit); Timer::Fine::Wait( us4); }
+void transmit_toggle( uint16_t us4) { toggle( transmit); delay_4us( us4); }
+#endif
+
 /**
  * Send a single symbol.
  */
-void send_symbol(const Encoding::Symbol &symbol)
+inline void send_symbol( uint16_t us4_high, uint16_t us4_low)
 {
-    toggle( transmit);
-    delay_4us( symbol[0]);
-    toggle( transmit);
-    delay_4us( symbol[1]);
+    transmit_toggle( us4_high);
+    transmit_toggle( us4_low);
 }
 
 /**
- * Send a command (as encoded by value) using the Encoding described by code
+ * Send a command (as encoded by value) using the Encoding symbols[protocol].
+ *
+ * Every protocol gets its own instantiation of this function, in which the
+ * preamble tests are resolved at compile time and the only remaining branch per
+ * bit is the choice between the two symbols.
+ *
+ * The pulse widths are corrected for the oscillator temperature once, before
+ * the transmission starts, and then kept in registers, so that the symbol loop
+ * does no more work than with the uncorrected immediate values.
  */
-void send_command_once(const Encoding &code, uint32_t value)
+template<uint8_t protocol>
+void send_command_once( uint32_t value)
 {
+    constexpr const Encoding &code = symbols[protocol];
+
+    const uint16_t zero_high = Compensation::Scale( code.alphabet[0][0]);
+    const uint16_t zero_low  = Compensation::Scale( code.alphabet[0][1]);
+    const uint16_t one_high  = Compensation::Scale( code.alphabet[1][0]);
+    const uint16_t one_low   = Compensation::Scale( code.alphabet[1][1]);
+
     set( led);
+    begin_transmission();
     if (code.us4_start_high)
     {
-        set( transmit);
-        delay_4us( code.us4_start_high);
+        transmit_high( Compensation::Scale( code.us4_start_high));
     }
 
     if (code.us4_start_low)
     {
-    	clear( transmit);
-    	delay_4us( code.us4_start_low);
+    	transmit_low( Compensation::Scale( code.us4_start_low));
     }
 
-    uint8_t bitcounter = code.bits;
-
-    while (bitcounter--)
+    begin_symbols();
+    for (uint8_t bitcounter = code.bits; bitcounter; --bitcounter)
     {
-        send_symbol( code.alphabet[value & 0x01]);
+        if (value & 0x01)
+        {
+            send_symbol( one_high, one_low);
+        }
+        else
+        {
+            send_symbol( zero_high, zero_low);
+        }
         value >>= 1;
     }
+    end_symbols();
 
-    clear( transmit);
+    end_transmission();
     clear( led);
 }
 
 /**
- * Send a command several times.
+ * Transmit kernels, one for each entry in symbols[].
+ */
+typedef void (*Kernel)( uint32_t value);
+const Kernel kernels[] PROGMEM = {
+    &send_command_once<quigg>,
+    &send_command_once<impuls>,
+    &send_command_once<globaltronic>
+};
+static_assert( Size( kernels) == Size( symbols), "every encoding needs a transmit kernel");
+
+/**
+ * A switch command as received over MQTT.
+ */
+struct Command
+{
+    uint8_t switch_index;
+    uint8_t onoff;
+    uint32_t received; ///< fine timer value at reception
+    uint8_t history;   ///< handle of the History entry
+};
+
+Queue<Command, 8> commands;
+
+/**
+ * A command that is ready for transmission: all table lookups have been done.
+ */
+struct Transmission
+{
+    Kernel send_once;
+    uint32_t value;
+    uint32_t us4_between_repeats;
+    uint8_t repeats;
+    uint32_t received;
+    uint8_t history;
+};
+
+/**
+ * Take the next command from the queue and prepare it for transmission.
  *
- * In practice most RF transmitters send the code several times to increase the
- * chances of command reception.
+ * Preparing amounts to looking up the transmit kernel, the code and the
+ * temperature corrected gap, so that no table lookups are left between two
+ * commands. The pulses themselves are not rendered in advance, the kernels
+ * generate them while transmitting.
+ *
+ * Commands are validated before they enter the queue, see update().
+ * Returns false if the queue was empty.
  */
-void send_command( const Encoding &code, uint32_t value, uint8_t count = 12)
+bool prepare_next( Transmission &transmission)
 {
-    for (; count; --count)
+    Command command;
+    if (not commands.Pop( command)) return false;
+
+    const Switch &selected = switches[command.switch_index];
+    const uint8_t encoding = selected.encoding;
+    transmission.send_once = reinterpret_cast<Kernel>( pgm_read_word( &kernels[encoding]));
+    transmission.value = selected.signals[command.onoff];
+    transmission.us4_between_repeats = Compensation::Scale( symbols[encoding].us4_between_repeats);
+    transmission.repeats = 12;
+    transmission.received = command.received;
+    transmission.history = command.history;
+    return true;
+}
+
+/**
+ * Wait for the gap after a transmission, receiving esp-link frames meanwhile.
+ *
+ * The gap is timed against the fine timer, so that long gaps don't accumulate
+ * the error of a delay loop. In gaps of at least gapServiceMinimum, incoming
+ * frames are processed until gapServiceMargin before the deadline, which puts any
+ * switch commands in the queue. The callbacks don't publish anything, that is left
+ * to publish_deferred(), so processing a frame takes a bounded time. Any overrun
+ * of the deadline is recorded in overrunStatistics in units of 4us.
+ *
+ * If last is true, the next command is prepared into next during the gap and
+ * available reports whether there was one.
+ */
+void wait_gap( uint32_t us4_gap, bool last, bool &available, Transmission &next)
+{
+    static constexpr uint32_t gapServiceMinimum = 2000 / 4;
+    static constexpr uint32_t gapServiceMargin = 1000 / 4;
+
+    const uint32_t deadline = Timer::Fine::GetCurrent() + us4_gap;
+    if (us4_gap >= gapServiceMinimum)
     {
-        send_command_once(code, value);
-        delay_4us( code.us4_between_repeats);
+        while (not Timer::Fine::HasPassed( deadline - gapServiceMargin))
+        {
+            if (uart.data_available()) esp.try_receive();
+        }
+    }
+
+    if (last) available = prepare_next( next);
+
+    const uint32_t late = Timer::Fine::GetCurrent() - deadline;
+    if (static_cast<int32_t>( late) >= 0)
+    {
+        overrunStatistics.Add( late > 0xffff ? 0xffff : late);
+    }
+    else
+    {
+        overrunStatistics.Add( 0);
+        Timer::Fine::WaitUntil( deadline);
     }
 }
 
 /**
- * Given a switchs number and an on/of code (0 or 1),
- * emit the RF command for the given switch.
+ * Transmit all queued commands, each one several times.
  *
- * This function will have no effect if switch_index is
- * outside the range of available switches or if onoff is more
- * than 1.
+ * In practice most RF transmitters send the code several times to increase the
+ * chances of command reception.
+ *
+ * This is a two-stage pipeline: the next command is prepared during the gap that
+ * follows the last repeat of the current one, so that consecutive commands are
+ * separated by just the protocol gap.
+ *
+ * The dead time of each command, the time between the moment it could have been
+ * transmitted and the moment it was, is recorded in deadTimeStatistics in units
+ * of 4us.
  */
-void sendcode( uint8_t switch_index, uint8_t onoff)
+void transmit_queued()
 {
-    if (switch_index < Size( switches) and onoff < Size( switches[switch_index].signals))
+    /// fine timer value at the end of the previous command or, once the queue
+    /// has run empty, at the last time it was found empty.
+    static uint32_t previous_end = 0;
+
+    Transmission transmissions[2];
+    uint8_t current = 0;
+    bool available = prepare_next( transmissions[current]);
+    if (not available)
     {
-        send_command(
-                symbols[ switches[switch_index].encoding],
-                switches[switch_index].signals[onoff]);
+        previous_end = Timer::Fine::GetCurrent();
+        return;
+    }
+
+    // every ADC interrupt would stretch the symbol that is being timed by
+    // delay_4us() by its full run time.
+    Analog::Pause();
+
+    // calibration time stamps arriving now will be processed late.
+    Calibration::Disturb();
+    while (available)
+    {
+        const Transmission &transmission = transmissions[current];
+        const auto start = Timer::GetCurrent();
+        const uint32_t fine_start = Timer::Fine::GetCurrent();
+
+        // the command could have started at reception or at the end of the
+        // previous command, whichever came last.
+        const uint32_t since_received = fine_start - transmission.received;
+        const uint32_t since_previous = fine_start - previous_end;
+        const uint32_t dead_time = since_received < since_previous ? since_received : since_previous;
+        deadTimeStatistics.Add( dead_time > 0xffff ? 0xffff : dead_time);
+
+        // the history keeps the latency in timer ticks of 128us.
+        const uint32_t latency = since_received / 32;
+        History::Sent( transmission.history, transmission.repeats, latency > 0xffff ? 0xffff : latency);
+
+        for (uint8_t count = transmission.repeats; count; --count)
+        {
+            transmission.send_once( transmission.value);
+            wait_gap( transmission.us4_between_repeats, count == 1, available, transmissions[current ^ 1]);
+        }
+
+        previous_end = Timer::Fine::GetCurrent();
+        Telemetry::Add( Telemetry::commands);
+        Telemetry::Add( Telemetry::airTime, Timer::GetCurrent() - start);
+        motionTimeout = Timer::After( 4 * Timer::ticksPerSecond);
+        current ^= 1;
     }
+    Analog::Resume();
 }
 
 /**
@@ -265,6 +536,102 @@ uint16_t parse_uint16( const char *(&input), const char *end)
     return value;
 }
 
+/**
+ * Parse a decimal number that makes up all of the characters in [input, end)
+ * and that must be less than limit.
+ *
+ * Unlike parse_uint16(), this function rejects empty input, anything that is
+ * not a digit and values that don't fit in a uint8_t. Values of limit or more are
+ * rejected with the given reason. Every rejection is counted in the telemetry.
+ */
+bool parse_strict( const char *input, const char *end, uint8_t limit, Telemetry::Value out_of_range, uint8_t &value)
+{
+    Telemetry::Value reason = Telemetry::rejectedSyntax;
+    uint16_t result = 0;
+    if (input != end)
+    {
+        for (; input != end; ++input)
+        {
+            const uint8_t digit = *input - '0';
+            if (digit > 9) break;
+
+            result = 10 * result + digit;
+            if (result > 0xff)
+            {
+                reason = Telemetry::rejectedOverflow;
+                break;
+            }
+        }
+
+        if (input == end)
+        {
+            if (result < limit)
+            {
+                value = result;
+                return true;
+            }
+            reason = out_of_range;
+        }
+    }
+
+    Telemetry::Add( reason);
+    return false;
+}
+
+/**
+ * Same as parse_strict(), but for values up to and including maximum, which may
+ * be anything that fits in 16 bits.
+ */
+bool parse_strict16( const char *input, const char *end, uint16_t maximum, Telemetry::Value out_of_range, uint16_t &value)
+{
+    Telemetry::Value reason = Telemetry::rejectedSyntax;
+    uint32_t result = 0;
+    if (input != end)
+    {
+        for (; input != end; ++input)
+        {
+            const uint8_t digit = *input - '0';
+            if (digit > 9) break;
+
+            result = 10 * result + digit;
+            if (result > 0xffff)
+            {
+                reason = Telemetry::rejectedOverflow;
+                break;
+            }
+        }
+
+        if (input == end)
+        {
+            if (result <= maximum)
+            {
+                value = result;
+                return true;
+            }
+            reason = out_of_range;
+        }
+    }
+
+    Telemetry::Add( reason);
+    return false;
+}
+
+/**
+ * Same as parse_uint16(), but for 32-bit values. Values that do not fit will
+ * silently wrap, which is intended for reference time stamps of which only
+ * differences are used.
+ */
+uint32_t parse_uint32( const char *(&input), const char *end)
+{
+    uint32_t value = 0;
+    while ( input < end and *input and *input <= '9' and *input >= '0')
+    {
+        value = 10 * value + (*input - '0');
+        ++input;
+    }
+    return value;
+}
+
 /**
  * Consume as many charactres from the character array pointed to by "input" as
  * match the expectation.
@@ -287,6 +654,156 @@ void clear_uart()
     while (uart.data_available()) uart.get();
 }
 
+/**
+ * Publish a message without waiting for esp-link.
+ *
+ * Returns a request id that can be checked with Requests::Done(). If a completion
+ * function is given, it is called when esp-link reports that the message was sent.
+ */
+uint8_t publish( const char *topic, const char *message, bool retain = false, Requests::Completion completion = nullptr)
+{
+    esp.execute( esp_link::mqtt::publish, topic, message, 0, retain);
+    return Requests::Add( completion);
+}
+
+/**
+ * Publish the summary of statistics on the given topic and the histogram on
+ * histogram_topic, and reset them if requested. The two parts are formatted
+ * one after the other to keep the stack use low.
+ */
+void publish_statistics( const char *topic, const char *histogram_topic, Statistics &statistics, bool reset)
+{
+    {
+        char text[Statistics::summarySize];
+        statistics.FormatSummary( text);
+        publish( topic, text);
+    }
+    {
+        char text[Statistics::histogramSize];
+        statistics.FormatHistogram( text);
+        publish( histogram_topic, text);
+    }
+    if (reset) statistics.Reset();
+}
+
+/**
+ * Handle a request on one of the spider/debug/ topics. The remainder of the
+ * topic selects what to publish, a message "reset" will reset the
+ * corresponding statistics after publishing.
+ *
+ * The report is only marked here and published by publish_debug_reports().
+ */
+void debug_request( const char *name, const char *name_end, const esp_link::string_ref &message)
+{
+    const char *message_ptr = message.buffer;
+    const bool reset = consume( message_ptr, message.buffer + message.len, "reset");
+
+    // consume() advances the pointer even when it fails, so every
+    // comparison starts again at the beginning of the name.
+    const char *name_ptr = name;
+    uint16_t report = 0;
+    if (consume( name_ptr, name_end, "loop"))                           report = loopReport;
+    else if (consume( name_ptr = name, name_end, "deadtime"))           report = deadTimeReport;
+    else if (consume( name_ptr = name, name_end, "rtt"))                report = rttReport;
+    else if (consume( name_ptr = name, name_end, "link"))               report = linkReport;
+    else if (consume( name_ptr = name, name_end, "overrun"))            report = overrunReport;
+    else if (consume( name_ptr = name, name_end, "light"))              report = lightReport;
+    else if (consume( name_ptr = name, name_end, "compensation"))       report = compensationReport;
+    else if (consume( name_ptr = name, name_end, "history"))            report = historyReport;
+    else if (consume( name_ptr = name, name_end, "memory"))             report = memoryReport;
+
+    debugReports |= report;
+    if (reset) debugResets |= report;
+}
+
+/**
+ * Publish the reports requested with debug_request().
+ */
+void publish_debug_reports()
+{
+    const uint16_t reports = debugReports;
+    const uint16_t resets = debugResets;
+    debugReports = 0;
+    debugResets = 0;
+
+    if (reports & loopReport)
+    {
+        publish_statistics( MQTT_BASE_NAME "stats/loop", MQTT_BASE_NAME "stats/loop/histogram",
+                            loopStatistics, resets & loopReport);
+    }
+    if (reports & deadTimeReport)
+    {
+        publish_statistics( MQTT_BASE_NAME "stats/deadtime", MQTT_BASE_NAME "stats/deadtime/histogram",
+                            deadTimeStatistics, resets & deadTimeReport);
+    }
+    if (reports & rttReport)
+    {
+        publish_statistics( MQTT_BASE_NAME "stats/rtt", MQTT_BASE_NAME "stats/rtt/histogram",
+                            rttStatistics, resets & rttReport);
+    }
+    if (reports & linkReport)
+    {
+        publish_statistics( MQTT_BASE_NAME "stats/link", MQTT_BASE_NAME "stats/link/histogram",
+                            linkStatistics, resets & linkReport);
+    }
+    if (reports & overrunReport)
+    {
+        publish_statistics( MQTT_BASE_NAME "stats/overrun", MQTT_BASE_NAME "stats/overrun/histogram",
+                            overrunStatistics, resets & overrunReport);
+    }
+    if (reports & lightReport)
+    {
+        char text[Format::decimalSize16];
+        Format::Decimal( Analog::Read( Analog::light), text);
+        publish( MQTT_BASE_NAME "stats/light", text);
+    }
+    if (reports & compensationReport)
+    {
+        char text[Compensation::formatSize];
+        Compensation::Format( text);
+        publish( MQTT_BASE_NAME "stats/compensation", text);
+    }
+    if (reports & historyReport)
+    {
+        char batch[History::maxFrameSize];
+        History::Encode( batch);
+        publish( MQTT_BASE_NAME "stats/history", batch);
+    }
+    if (reports & memoryReport)
+    {
+        char text[Memory::formatSize];
+        Memory::Format( text);
+        publish( MQTT_BASE_NAME "stats/memory", text);
+    }
+}
+
+/**
+ * Reset into the bootloader, which will wait for a new firmware image.
+ *
+ * The bootloader recognizes an update request by the watchdog reset.
+ */
+void start_bootloader()
+{
+    // tell controllers that this node is going away, the last will would
+    // only fire after the broker's keepalive timeout, if at all.
+    publish( MQTT_BASE_NAME "status", "offline", true);
+
+    // wait until esp-link has sent both, but not forever.
+    const auto status = publish( MQTT_BASE_NAME "firmware/status", "bootloader");
+    const auto timeout = Timer::After( Timer::ticksPerSecond / 2);
+    while (not Requests::Done( status) and not Timer::HasPassed( timeout))
+    {
+        esp.try_receive();
+    }
+
+    // a sync makes esp-link forget the MQTT callbacks, otherwise it would keep
+    // sending SLIP frames to the bootloader.
+    esp.sync();
+    cli();
+    wdt_enable( WDTO_15MS);
+    for (;;) /* wait for the watchdog */;
+}
+
 /**
  * This function is called when an update is received on the subscribed MQTT topic.
  */
@@ -307,53 +824,399 @@ void update( const esp_link::packet *p, uint16_t size)
     if (consume(topic_ptr, topic_end, MQTT_BASE_NAME "switch/"))
     {
         // ...try to parse the switch number from the topic and the
-        // on/off number from the message.
-        uint8_t sw = parse_uint16( topic_ptr, topic_end);
-        uint8_t onoff = parse_uint16(message.buffer, message.buffer + message.len);
+        // on/off number from the message. Anything that is not exactly
+        // a known switch and 0 or 1 is rejected here, so that no air time
+        // is wasted on it.
+        const uint8_t source = History::Hash( topic.buffer, topic.len);
+        uint8_t sw = History::unknown;
+        uint8_t onoff = History::unknown;
+        if (not parse_strict( topic_ptr, topic_end, Size( switches), Telemetry::rejectedSwitch, sw)
+            or not parse_strict( message.buffer, message.buffer + message.len, Size( switches[0].signals), Telemetry::rejectedAction, onoff))
+        {
+            History::Add( source, sw, onoff, History::invalid);
+            return;
+        }
 
-        // ... and send the corresponding code.
-        sendcode( sw, onoff);
+        // ... and queue the command for transmission.
+        const uint8_t entry = History::Add( source, sw, onoff, History::queued);
+        if (not commands.Push( Command{ sw, onoff, Timer::Fine::GetCurrent(), entry}))
+        {
+            Telemetry::Add( Telemetry::rejectedQueueFull);
+            History::Dropped( entry);
+        }
+        commandsSinceProbe = true;
         motionTimeout = Timer::After( 4 * Timer::ticksPerSecond);
     }
+    else if (consume( topic_ptr = topic.buffer, topic_end, MQTT_BASE_NAME "probe"))
+    {
+        // the message is the timer value at the moment the probe was sent.
+        const char *message_ptr = message.buffer;
+        rttStatistics.Add( Timer::GetCurrent() - parse_uint16( message_ptr, message.buffer + message.len));
+    }
+    else if (consume( topic_ptr = topic.buffer, topic_end, MQTT_BASE_NAME "time"))
+    {
+        // the answer of the time server: our request followed by its time.
+        const char *message_ptr = message.buffer;
+        const char *message_end = message.buffer + message.len;
+        const uint32_t sent = parse_uint32( message_ptr, message_end);
+        if (consume( message_ptr, message_end, " "))
+        {
+            Clock::Sample( sent, parse_uint32( message_ptr, message_end));
+        }
+    }
+    else if (consume( topic_ptr = topic.buffer, topic_end, MQTT_BASE_NAME "debug/"))
+    {
+        debug_request( topic_ptr, topic_end, message);
+    }
+    else if (consume( topic_ptr = topic.buffer, topic_end, MQTT_BASE_NAME "firmware"))
+    {
+        const char *message_ptr = message.buffer;
+        if (consume( message_ptr, message.buffer + message.len, "update"))
+        {
+            // leave the esp-link callback before resetting, the main
+            // loop will start the bootloader.
+            bootloaderRequested = true;
+        }
+    }
+    else if (consume( topic_ptr = topic.buffer, topic_end, MQTT_BASE_NAME "occupancy/timeout"))
+    {
+        // vacancy timeout in seconds.
+        const char *message_ptr = message.buffer;
+        const uint16_t seconds = parse_uint16( message_ptr, message.buffer + message.len);
+        if (seconds) Occupancy::SetTimeout( seconds);
+    }
+    else if (consume( topic_ptr = topic.buffer, topic_end, MQTT_BASE_NAME "light/threshold"))
+    {
+        // "<low> <high>", in units of 1/4096 of the supply voltage, with
+        // low below high. Anything else leaves the thresholds unchanged.
+        const char *message_end = message.buffer + message.len;
+        const char *separator = message.buffer;
+        while (separator != message_end and *separator != ' ') ++separator;
+
+        uint16_t low;
+        uint16_t high;
+        if (separator == message_end)
+        {
+            Telemetry::Add( Telemetry::rejectedSyntax);
+        }
+        else if (parse_strict16( message.buffer, separator, Analog::maximum, Telemetry::rejectedThreshold, low)
+                and parse_strict16( separator + 1, message_end, Analog::maximum, Telemetry::rejectedThreshold, high))
+        {
+            if (low < high)
+            {
+                Analog::SetThresholds( Analog::light, low, high);
+            }
+            else
+            {
+                Telemetry::Add( Telemetry::rejectedThreshold);
+            }
+        }
+    }
+    else if (consume( topic_ptr = topic.buffer, topic_end, MQTT_BASE_NAME "calibrate"))
+    {
+        const char *message_ptr = message.buffer;
+        if (Calibration::Reference( parse_uint32( message_ptr, message.buffer + message.len)))
+        {
+            // writing EEPROM and publishing both take milliseconds.
+            calibrationReportRequested = true;
+        }
+    }
 }
 
-const char *tohex( uint16_t value)
+/**
+ * Called by esp-link when an MQTT publish has been sent.
+ */
+void published( const esp_link::packet *p, uint16_t size)
 {
-	static char hex[5] = {};
-	static constexpr char digits[] = {
-			'0', '1', '2', '3',
-			'4', '5', '6', '7',
-			'8', '9', 'A', 'B',
-			'C', 'D', 'E', 'F'
-	};
+    if (Requests::InFlight())
+    {
+        linkStatistics.Add( Requests::Complete());
+    }
 
-	hex[3] = digits[ value % 16];
-	value /= 16;
-	hex[2] = digits[ value % 16];
-	value /= 16;
-	hex[1] = digits[ value % 16];
-	value /= 16;
-	hex[0] = digits[ value % 16];
+    // the whole path up to the broker works.
+    mqttConnected = true;
+    syncBackoff = minimumSyncBackoff;
+}
 
-	return hex;
+/**
+ * Called by esp-link when the MQTT connection was lost. Outstanding
+ * publishes will not be reported anymore.
+ */
+void disconnected( const esp_link::packet *p, uint16_t size)
+{
+    mqttConnected = false;
+    Requests::Reset();
+    syncTimeout = Timer::After( maximumSyncBackoff);
 }
 
+/**
+ * Called by esp-link when the MQTT connection is (re-)established.
+ */
 void connected( const esp_link::packet *p, uint16_t size)
+{
+    mqttConnected = true;
+    subscriptionsRequested = true;
+}
+
+/**
+ * Subscribe to all topics and announce this node.
+ *
+ * None of the requests below wait for an answer, so all of them go out
+ * in a single burst.
+ */
+void subscribe_all()
 {
     using esp_link::mqtt::subscribe;
-    using esp_link::mqtt::publish;
     static uint16_t reconnect_count = 0;
+    char count[Format::hexSize16];
+    Format::Hex( ++reconnect_count, count);
 	//esp.send("connected\n");
     esp.execute( subscribe, MQTT_BASE_NAME "switch/+", 0);
-    esp.execute( publish,   MQTT_BASE_NAME "connects", tohex( ++reconnect_count), 0, true);
+    esp.execute( subscribe, MQTT_BASE_NAME "debug/+", 0);
+    esp.execute( subscribe, MQTT_BASE_NAME "calibrate", 0);
+    esp.execute( subscribe, MQTT_BASE_NAME "firmware", 0);
+    esp.execute( subscribe, MQTT_BASE_NAME "probe", 0);
+    esp.execute( subscribe, MQTT_BASE_NAME "time", 0);
+    esp.execute( subscribe, MQTT_BASE_NAME "occupancy/timeout", 0);
+    esp.execute( subscribe, MQTT_BASE_NAME "light/threshold", 0);
+    publish( MQTT_BASE_NAME "connects", count, true);
+    publish( MQTT_BASE_NAME "status", "online", true);
 }
 
+/**
+ * Publish the next binary telemetry frame.
+ *
+ * Telemetry is skipped while the link is congested, the next frame
+ * will contain the accumulated differences.
+ */
+void publish_telemetry()
+{
+    if (not linked or Requests::InFlight() > Requests::capacity / 2) return;
+
+    char frame[Telemetry::maxFrameSize];
+    Telemetry::Set( Telemetry::loopMax, loopStatistics.Max());
+    Telemetry::Set( Telemetry::time, Clock::Now());
+    Telemetry::Set( Telemetry::stackMax, Memory::StackMaximum());
+    Telemetry::Set( Telemetry::temperature, Compensation::Temperature());
+    Telemetry::Set( Telemetry::compensation, Compensation::Correctionppm());
+    Telemetry::Encode( frame);
+    publish( MQTT_BASE_NAME "telemetry", frame);
 }
 
-int main(void)
+/**
+ * Do the work that the esp-link callbacks left for the main loop.
+ *
+ * Callbacks also run while frames are received during inter-repeat gaps, see
+ * wait_gap(). Publishing at 19200 baud takes several milliseconds per message,
+ * so callbacks only take note and the publishing happens here.
+ */
+void publish_deferred()
+{
+    if (subscriptionsRequested)
+    {
+        subscriptionsRequested = false;
+        subscribe_all();
+    }
+
+    if (calibrationReportRequested)
+    {
+        calibrationReportRequested = false;
+        if (Calibration::Converged()) Compensation::StoreReference();
+
+        char text[Calibration::formatSize];
+        Calibration::Format( text);
+        publish( MQTT_BASE_NAME "stats/osccal", text, true);
+    }
+
+    if (debugReports) publish_debug_reports();
+}
+
+/**
+ * Publish a round trip probe: a message with the current timer value on a topic
+ * that this node subscribes to, followed by the round trip statistics so far.
+ *
+ * Probes are skipped while switch commands are coming in, or while the link is
+ * congested, so that they don't compete with real traffic.
+ */
+void send_probe()
+{
+    if (not linked or commandsSinceProbe or Requests::InFlight())
+    {
+        commandsSinceProbe = false;
+        return;
+    }
+
+    char stamp[Format::decimalSize16];
+    Format::Decimal( Timer::GetCurrent(), stamp);
+    publish( MQTT_BASE_NAME "probe", stamp);
+
+    if (rttStatistics.Count())
+    {
+        publish_statistics( MQTT_BASE_NAME "stats/rtt", MQTT_BASE_NAME "stats/rtt/histogram",
+                            rttStatistics, false);
+    }
+}
+
+/**
+ * Ask the time server for its time, see clock.h.
+ */
+void request_time()
+{
+    const uint32_t now = Timer::GetCurrentLong();
+    if (not linked or static_cast<int32_t>( now - nextTimeRequest) < 0) return;
+
+    char stamp[Format::decimalSize32];
+    Format::Decimal( now, stamp);
+    publish( MQTT_BASE_NAME "time/request", stamp);
+    nextTimeRequest = now + timeRequestInterval;
+}
+
+/**
+ * Publish a change in occupancy, followed by the time at which it happened.
+ */
+void publish_occupancy( bool occupied)
+{
+    char time[Format::decimalSize32];
+    Format::Decimal( Clock::Now(), time);
+    publish( MQTT_BASE_NAME "occupancy", occupied?"1":"0", true);
+    publish( MQTT_BASE_NAME "occupancy/at", time);
+}
+
+/**
+ * Publish the threshold crossings reported by the ADC sampler.
+ */
+void publish_crossings()
+{
+    Analog::Crossing crossing;
+    while (Analog::NextCrossing( crossing))
+    {
+        if (crossing.channel == Analog::light)
+        {
+            publish( MQTT_BASE_NAME "light", crossing.above?"1":"0", true);
+        }
+    }
+}
+
+/**
+ * Periodically publish how many milliseconds the area was occupied since
+ * the previous report.
+ *
+ * Nothing is published if the area was vacant for the whole period.
+ */
+void report_occupancy()
+{
+    const uint32_t now = Timer::GetCurrentLong();
+    if (not linked or static_cast<int32_t>( now - nextOccupancyReport) < 0) return;
+    nextOccupancyReport = now + occupancyReportInterval;
+
+    const uint32_t ticks = Occupancy::TakeOccupiedTicks();
+    if (not ticks and not Occupancy::Occupied()) return;
+
+    char duration[Format::decimalSize32];
+    Format::Decimal( Clock::TicksToMilliseconds( ticks), duration);
+    publish( MQTT_BASE_NAME "occupancy/duration", duration);
+}
+
+/**
+ * Schedule the next synchronization attempt after the current backoff time
+ * and double the backoff time for the attempt after that.
+ *
+ * The backoff time is only reset once a publish has made it through, so that
+ * neither a rebooting ESP8266 nor an unreachable broker cause a flood of
+ * synchronization attempts.
+ */
+void postpone_sync()
+{
+    syncTimeout = Timer::After( syncBackoff);
+    syncBackoff = syncBackoff < maximumSyncBackoff / 2 ? 2 * syncBackoff : maximumSyncBackoff;
+}
+
+/**
+ * Try to synchronize with esp-link and set up MQTT.
+ */
+void try_sync()
 {
     using esp_link::mqtt::setup;
-    using esp_link::mqtt::publish;
+    using esp_link::mqtt::lwt;
+
+    if (esp.sync())
+    {
+        esp.execute( setup, &connected, &disconnected, &published, &update);
+
+        // topic, message, qos and retain flag of the last will. esp-link
+        // hands the last will to the broker when it connects, so this only
+        // applies from esp-link's next MQTT connection on, not to the
+        // current one.
+        esp.execute( lwt, MQTT_BASE_NAME "status", "offline", 0, 1);
+        linked = true;
+
+        // publishes from before the sync will never be reported.
+        Requests::Reset();
+
+        // esp-link only reports changes of the MQTT connection, so subscribe
+        // now in case it is connected already. Whether it is, is decided by
+        // the connected() or published() callbacks.
+        mqttConnected = false;
+        subscriptionsRequested = true;
+        syncTimeout = Timer::After( maximumSyncBackoff);
+    }
+    else
+    {
+        Telemetry::Add( Telemetry::syncFailures);
+        toggle( led);
+        linked = false;
+        postpone_sync();
+    }
+}
+
+/**
+ * Link health state machine.
+ *
+ * While not linked, synchronization is attempted with a backoff. Once linked,
+ * every publish doubles as a probe: when esp-link doesn't report a publish as sent
+ * within linkTimeout while MQTT is connected, the link is checked with a sync.
+ * A missing report alone doesn't prove much, esp-link silently drops publishes
+ * it cannot send. Only when the sync fails is the ESP assumed to be dead and
+ * does synchronization start over with the minimum backoff. A successful sync
+ * registers the callbacks again, in case the ESP rebooted unnoticed.
+ *
+ * While MQTT is not connected there are no publishes to go by, and an ESP that
+ * rebooted in the meantime has forgotten the callbacks and will never report a
+ * connection. Synchronization is therefore repeated every maximumSyncBackoff
+ * until MQTT is connected.
+ */
+void monitor_link()
+{
+    // requests that esp-link dropped would otherwise never free their slot.
+    const uint8_t expired = Requests::Expire( linkTimeout);
+
+    if (not linked or not mqttConnected)
+    {
+        if (Timer::HasPassedOnce( syncTimeout)) try_sync();
+    }
+    else if (expired)
+    {
+        try_sync();
+        if (not linked)
+        {
+            Telemetry::Add( Telemetry::linkFailures);
+            mqttConnected = false;
+        }
+    }
+}
+
+}
+
+int main(void)
+{
+
+    // a watchdog reset without bootloader would leave the watchdog running.
+    MCUSR = 0;
+    wdt_disable();
+
+    Calibration::Load();
+    Compensation::Load();
+    Analog::Start();
 
     make_output( led|transmit);
     make_input( pir);
@@ -364,23 +1227,76 @@ int main(void)
     _delay_ms( 5000); // wait for an eternity.
     clear_uart();    // then clear everything received on uart.
 
-    while (not esp.sync()) toggle( led);
-    esp.execute( setup, &connected, nullptr, nullptr, &update);
-    connected(nullptr, 0);
+    syncBackoff = minimumSyncBackoff;
 
     bool previous_pir_value = false;
+    bool motion_held_off = false;
+    uint32_t previous_iteration = Timer::Fine::GetCurrent();
     for (;;)
     {
+        const uint32_t now = Timer::Fine::GetCurrent();
+        const uint32_t iteration = now - previous_iteration;
+        loopStatistics.Add( iteration > 0xffff ? 0xffff : iteration);
+        previous_iteration = now;
+
     	bool pir_value = read( pir);
     	if (pir_value != previous_pir_value)
     	{
-    		if (Timer::HasPassedOnce( motionTimeout))
+    		Telemetry::Add( Telemetry::motionEvents);
+
+    		// transmitting may trigger the PIR, so ignore motion during the
+    		// hold-off, but never miss the end of motion.
+    		if (pir_value and not Timer::HasPassedOnce( motionTimeout))
+    		{
+    			motion_held_off = true;
+    		}
+    		else if (Occupancy::Motion( pir_value))
     		{
-    			esp.execute( publish, MQTT_BASE_NAME "motion", pir_value?"1":"0", 0, false);
+    			publish_occupancy( true);
     		}
     		previous_pir_value = pir_value;
     	}
 
+    	// motion that started during the hold-off and still goes on when
+    	// the hold-off ends would otherwise never cause an edge.
+    	if (motion_held_off and Timer::HasPassedOnce( motionTimeout))
+    	{
+    		motion_held_off = false;
+    		if (read( pir) and Occupancy::Motion( true))
+    		{
+    			publish_occupancy( true);
+    		}
+    	}
+
+    	if (Occupancy::Expired())
+    	{
+    	    publish_occupancy( false);
+    	}
+
+        if (Timer::HasPassedOnce( telemetryTimeout))
+        {
+            publish_telemetry();
+            telemetryTimeout = Timer::After( telemetryInterval);
+        }
+
+        if (Timer::HasPassedOnce( probeTimeout))
+        {
+            send_probe();
+            probeTimeout = Timer::After( probeInterval);
+        }
+
+        Memory::Step();
+        if (Analog::Ready( Analog::temperature))
+        {
+            Compensation::Update( Analog::Read( Analog::temperature));
+        }
+        monitor_link();
+        request_time();
+        report_occupancy();
+        publish_crossings();
         esp.try_receive();
+        publish_deferred();
+        transmit_queued();
+        if (bootloaderRequested) start_bootloader();
     }
 }
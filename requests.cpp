@@ -0,0 +1,110 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "requests.h"
+#include "queue.h"
+#include "timer.h"
+
+namespace
+{
+	struct Pending
+	{
+		uint8_t id;
+		uint16_t sent; ///< timer value when the request was sent
+		Requests::Completion completion;
+	};
+
+	Queue<Pending, Requests::capacity> pending;
+
+	/// id of the next request.
+	uint8_t nextId = 0;
+
+	/// id of the oldest request that has not completed yet, all
+	/// ids from oldest up to nextId are outstanding.
+	uint8_t oldest = 0;
+}
+
+namespace Requests
+{
+	/**
+	 * Register a request that was just sent and return its id.
+	 */
+	uint8_t Add( Completion completion)
+	{
+		if (pending.Full())
+		{
+			Pending lost;
+			pending.Pop( lost);
+			oldest = lost.id + 1;
+		}
+
+		const uint8_t id = nextId++;
+		pending.Push( Pending{ id, Timer::GetCurrent(), completion});
+		return id;
+	}
+
+	/**
+	 * Complete the oldest outstanding request. This is called from the esp-link
+	 * published callback.
+	 *
+	 * Returns the time in timer ticks that the request was in flight.
+	 */
+	uint16_t Complete()
+	{
+		Pending request;
+		if (not pending.Pop( request)) return 0;
+
+		oldest = request.id + 1;
+		if (request.completion) request.completion( request.id);
+		return Timer::GetCurrent() - request.sent;
+	}
+
+	/**
+	 * Forget all outstanding requests, for instance when the MQTT connection was
+	 * lost. Their completion callbacks will not be called.
+	 */
+	void Reset()
+	{
+		Pending request;
+		while (pending.Pop( request)) /* drop */;
+		oldest = nextId;
+	}
+
+	bool Done( uint8_t id)
+	{
+		return static_cast<uint8_t>( id - oldest) >= static_cast<uint8_t>( nextId - oldest);
+	}
+
+	uint8_t InFlight()
+	{
+		return pending.Size();
+	}
+
+	/**
+	 * Forget the requests that have been in flight for more than maxAge timer
+	 * ticks without calling their completion callbacks, and return how many
+	 * there were.
+	 *
+	 * Ages are measured with the 16-bit timer, so this must be called more often
+	 * than every 2^16 - maxAge ticks.
+	 */
+	uint8_t Expire( uint16_t maxAge)
+	{
+		const uint16_t now = Timer::GetCurrent();
+		uint8_t count = 0;
+		Pending lost;
+		while (not pending.Empty()
+				and static_cast<uint16_t>( now - pending.Front().sent) > maxAge
+				and pending.Pop( lost))
+		{
+			oldest = lost.id + 1;
+			++count;
+		}
+		return count;
+	}
+}
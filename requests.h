@@ -0,0 +1,43 @@
+/*
+ * requests.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef REQUESTS_H_
+#define REQUESTS_H_
+#include <stdint.h>
+
+/**
+ * Bookkeeping for MQTT publishes that are in flight.
+ *
+ * esp-link doesn't answer publish requests directly. Instead, it calls the
+ * "published" callback that was registered at MQTT setup once a message has been
+ * sent, in the order in which the messages were published. Every publish gets a
+ * request id and optionally a completion callback; every published callback
+ * completes the oldest outstanding request. This allows many publishes to be in
+ * flight without waiting for any of them.
+ *
+ * esp-link never reports a publish that it drops, for instance while the MQTT
+ * connection is down. Expire() gives up on such requests, so that they don't
+ * occupy a slot forever. Should a report for an expired request arrive after
+ * all, it completes the next request early.
+ */
+namespace Requests
+{
+	typedef void (*Completion)( uint8_t id);
+
+	uint8_t Add( Completion completion = nullptr);
+	uint16_t Complete();
+	void Reset();
+	bool Done( uint8_t id);
+	uint8_t InFlight();
+	uint8_t Expire( uint16_t maxAge);
+
+	/// maximum number of tracked requests. When more requests are added, the
+	/// oldest one is considered lost.
+	constexpr uint8_t capacity = 8;
+}
+
+#endif /* REQUESTS_H_ */
@@ -0,0 +1,200 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifdef RF_OUTPUT_SPI
+
+#include "spi_output.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr_utilities/pin_definitions.hpp>
+
+namespace
+{
+	PIN_TYPE( B, 2) ss;
+	PIN_TYPE( B, 3) mosi;
+	PIN_TYPE( B, 5) sck;
+
+	uint8_t chunks[2][SpiOutput::chunkSize];
+
+	/// number of bytes in each chunk that still need to be sent. The bytes of
+	/// a chunk are right-aligned, so the next byte to send is at
+	/// chunkSize - remaining.
+	volatile uint8_t remaining[2];
+
+	/// chunk that the SPI interrupt is sending.
+	volatile uint8_t sending;
+
+	/// set while the SPI interrupt is busy sending.
+	volatile bool running;
+
+	// rendering state
+	uint8_t rendering;
+	uint8_t filled;
+	uint8_t pending;
+	uint8_t pendingBits;
+	bool level;
+
+	/// half bit (4us) that was rounded away from the previous duration.
+	uint8_t carry;
+
+	/**
+	 * Hand the current chunk to the SPI interrupt and wait until the other
+	 * chunk is available for rendering.
+	 *
+	 * The chunk is queued before waiting, so that the SPI interrupt finds it
+	 * when it finishes the chunk it is sending and continues without a gap.
+	 * SPI only needs to be started here if it was idle, which means that it
+	 * was not sending yet or that rendering fell behind.
+	 */
+	void Submit( uint8_t size)
+	{
+		cli();
+		remaining[rendering] = size;
+		if (not running)
+		{
+			running = true;
+			sending = rendering;
+			SPDR = chunks[rendering][SpiOutput::chunkSize - size];
+		}
+		sei();
+
+		rendering ^= 1;
+		filled = 0;
+		while (remaining[rendering]) /* wait for the SPI interrupt */;
+	}
+
+	void Put( uint8_t byte)
+	{
+		chunks[rendering][filled] = byte;
+		if (++filled == SpiOutput::chunkSize)
+		{
+			Submit( filled);
+		}
+	}
+
+	/**
+	 * Append a number of bits with the current level to the bitstream.
+	 */
+	void Render( uint32_t us4)
+	{
+		us4 += carry;
+		carry = us4 & 1;
+		uint32_t bits = us4 >> 1;
+
+		const uint8_t pattern = level ? 0xff : 0x00;
+		while (bits and pendingBits)
+		{
+			pending = (pending << 1) | (pattern & 1);
+			--bits;
+			if (++pendingBits == 8)
+			{
+				Put( pending);
+				pendingBits = 0;
+			}
+		}
+
+		for (; bits >= 8; bits -= 8)
+		{
+			Put( pattern);
+		}
+
+		for (; bits; --bits)
+		{
+			pending = (pending << 1) | (pattern & 1);
+			++pendingBits;
+		}
+	}
+}
+
+ISR( SPI_STC_vect)
+{
+	uint8_t chunk = sending;
+	uint8_t left = remaining[chunk] - 1;
+	remaining[chunk] = left;
+	if (not left)
+	{
+		chunk ^= 1;
+		left = remaining[chunk];
+		sending = chunk;
+		if (not left)
+		{
+			running = false;
+			return;
+		}
+	}
+	SPDR = chunks[chunk][SpiOutput::chunkSize - left];
+}
+
+namespace SpiOutput
+{
+	/**
+	 * Enable the SPI peripheral as master at clk/64, which gives one bit
+	 * per 8us at 8MHz.
+	 */
+	void Start()
+	{
+		static_assert( F_CPU == 8000000, "This code assumes a 8 Mhz clock");
+		make_output( ss|mosi|sck);
+		SPCR = _BV( SPIE) | _BV( SPE) | _BV( MSTR) | _BV( SPR1);
+		SPSR = 0;
+		rendering = 0;
+		filled = 0;
+		pendingBits = 0;
+		carry = 0;
+		level = false;
+	}
+
+	void High( uint32_t us4)
+	{
+		level = true;
+		Render( us4);
+	}
+
+	void Low( uint32_t us4)
+	{
+		level = false;
+		Render( us4);
+	}
+
+	void Toggle( uint16_t us4)
+	{
+		level = not level;
+		Render( us4);
+	}
+
+	/**
+	 * Send out whatever is left, wait for the bitstream to finish and release the
+	 * MOSI pin, which then becomes low.
+	 */
+	void Finish()
+	{
+		if (pendingBits)
+		{
+			level = false;
+			Render( 2 * (8 - pendingBits));
+		}
+
+		// right-align the last, partially filled, chunk.
+		if (filled)
+		{
+			const uint8_t size = filled;
+			uint8_t *chunk = chunks[rendering];
+			for (uint8_t index = size; index; --index)
+			{
+				chunk[chunkSize - size + index - 1] = chunk[index - 1];
+			}
+			Submit( size);
+		}
+
+		while (running) /* wait */;
+		SPCR = 0;
+		clear( mosi);
+	}
+}
+
+#endif // RF_OUTPUT_SPI
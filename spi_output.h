@@ -0,0 +1,39 @@
+/*
+ * spi_output.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef SPI_OUTPUT_H_
+#define SPI_OUTPUT_H_
+#include <stdint.h>
+
+/**
+ * Optional RF output through the MOSI pin of the SPI peripheral, enabled by
+ * defining RF_OUTPUT_SPI.
+ *
+ * The waveform is rendered into a bitstream of one bit per 8us, which the SPI
+ * peripheral clocks out at 125kHz. Rendering happens in the caller's context into
+ * one of two chunk buffers while the SPI interrupt sends the other one, so that
+ * pulse widths are determined by the SPI clock instead of by cycle counting.
+ *
+ * The SPI peripheral has no transmit buffer, so the last bit of every byte is
+ * stretched by the latency of the SPI interrupt. This is typically a few
+ * microseconds, but may be longer while the UART interrupt is running.
+ *
+ * Durations are given in units of 4us, like in the Encoding struct, and are
+ * rounded to whole bits without accumulating rounding errors.
+ */
+namespace SpiOutput
+{
+	void Start();
+	void High( uint32_t us4);
+	void Low( uint32_t us4);
+	void Toggle( uint16_t us4);
+	void Finish();
+
+	constexpr uint8_t chunkSize = 16;
+}
+
+#endif /* SPI_OUTPUT_H_ */
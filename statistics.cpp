@@ -0,0 +1,103 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "statistics.h"
+#include "format.h"
+
+namespace
+{
+	/**
+	 * Return the number of significant bits in value, which is also the
+	 * index of the histogram bucket for that value.
+	 */
+	uint8_t Bucket( uint16_t value)
+	{
+		uint8_t bucket = 0;
+		if (value & 0xff00)
+		{
+			bucket = 8;
+			value >>= 8;
+		}
+
+		while (value)
+		{
+			++bucket;
+			value >>= 1;
+		}
+		return bucket;
+	}
+}
+
+void Statistics::Add( uint16_t sample)
+{
+	if (sample < min) min = sample;
+	if (sample > max) max = sample;
+	++count;
+	if (sum > 0xffffffff - sample)
+	{
+		sum /= 2;
+		summed /= 2;
+	}
+	sum += sample;
+	++summed;
+
+	uint16_t &bucket = histogram[Bucket( sample)];
+	if (bucket != 0xffff) ++bucket;
+}
+
+void Statistics::Reset()
+{
+	min = 0xffff;
+	max = 0;
+	count = 0;
+	sum = 0;
+	summed = 0;
+	for (auto &bucket : histogram) bucket = 0;
+}
+
+uint16_t Statistics::Average() const
+{
+	return summed ? sum / summed : 0;
+}
+
+/**
+ * Write the minimum, average, maximum and sample count as text.
+ *
+ * buffer must hold at least summarySize characters. Returns a pointer to the
+ * terminating zero.
+ */
+char *Statistics::FormatSummary( char *buffer) const
+{
+	buffer = Format::Decimal( count ? min : static_cast<uint16_t>( 0), buffer);
+	*buffer++ = ' ';
+	buffer = Format::Decimal( Average(), buffer);
+	*buffer++ = ' ';
+	buffer = Format::Decimal( max, buffer);
+	*buffer++ = ' ';
+	return Format::Decimal( count, buffer);
+}
+
+/**
+ * Write the histogram buckets as comma-separated text, up to the last bucket
+ * that is not empty.
+ *
+ * buffer must hold at least histogramSize characters. Returns a pointer to the
+ * terminating zero.
+ */
+char *Statistics::FormatHistogram( char *buffer) const
+{
+	uint8_t used = bucketCount;
+	while (used > 1 and not histogram[used - 1]) --used;
+
+	for (uint8_t bucket = 0; bucket < used; ++bucket)
+	{
+		if (bucket) *buffer++ = ',';
+		buffer = Format::Decimal( histogram[bucket], buffer);
+	}
+	return buffer;
+}
@@ -0,0 +1,61 @@
+/*
+ * statistics.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+#include <stdint.h>
+
+/**
+ * Running statistics of a series of 16-bit samples: minimum, maximum,
+ * average and a histogram with power-of-two buckets.
+ *
+ * Adding a sample costs a few compares and additions, the division needed
+ * for the average is only done when the statistics are formatted. When the
+ * sum of the samples would overflow, the sum and the number of samples in the
+ * average are both halved, so the average stays valid on long runs.
+ *
+ * The summary and the histogram are formatted separately, so that they can be
+ * published as two messages from two small buffers.
+ */
+class Statistics
+{
+public:
+	/// bucket 0 counts zero samples, bucket n counts samples in [2^(n-1), 2^n).
+	static constexpr uint8_t bucketCount = 17;
+
+	/// size of the buffer needed by FormatSummary(): three 16-bit and one
+	/// 32-bit number with separators and a terminating zero.
+	static constexpr uint8_t summarySize = 3 * 6 + 11;
+
+	/// size of the buffer needed by FormatHistogram().
+	static constexpr uint8_t histogramSize = bucketCount * 6;
+
+	Statistics()
+	{
+		Reset();
+	}
+
+	void Add( uint16_t sample);
+	void Reset();
+	char *FormatSummary( char *buffer) const;
+	char *FormatHistogram( char *buffer) const;
+
+	uint16_t Min() const { return min; }
+	uint16_t Max() const { return max; }
+	uint32_t Count() const { return count; }
+	uint16_t Average() const;
+
+private:
+	uint16_t min;
+	uint16_t max;
+	uint32_t count;
+	uint32_t sum;
+	uint32_t summed; ///< number of samples in sum, see Add()
+	uint16_t histogram[bucketCount];
+};
+
+#endif /* STATISTICS_H_ */
@@ -0,0 +1,118 @@
+//
+//  Copyright (C) 2026 agent
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "telemetry.h"
+
+namespace
+{
+	uint32_t values[Telemetry::valueCount];
+	uint32_t published[Telemetry::valueCount];
+	uint8_t sequence = 0;
+
+	/**
+	 * Write value as an unsigned base-128 varint and return a pointer
+	 * just beyond the last byte written.
+	 */
+	uint8_t *PutVarint( uint32_t value, uint8_t *output)
+	{
+		while (value >= 0x80)
+		{
+			*output++ = static_cast<uint8_t>( value) | 0x80;
+			value >>= 7;
+		}
+		*output++ = static_cast<uint8_t>( value);
+		return output;
+	}
+
+	/**
+	 * Map signed differences onto unsigned numbers so that small negative
+	 * differences also result in short varints.
+	 */
+	uint32_t Zigzag( uint32_t difference)
+	{
+		return (difference << 1) ^ -(difference >> 31);
+	}
+}
+
+namespace Telemetry
+{
+	/**
+	 * Increase a counter. Counters are allowed to wrap.
+	 */
+	void Add( Value value, uint16_t amount)
+	{
+		values[value] += amount;
+	}
+
+	/**
+	 * Set a value that is not a counter, but a momentary reading.
+	 */
+	void Set( Value value, uint32_t newValue)
+	{
+		values[value] = newValue;
+	}
+
+	/**
+	 * Create the next telemetry frame in buffer, which must be at least
+	 * maxFrameSize bytes large.
+	 *
+	 * Returns the length of the frame, excluding the terminating zero.
+	 */
+	uint8_t Encode( char *buffer)
+	{
+		uint8_t raw[maxRawSize];
+		uint8_t *output = raw;
+		const bool keyframe = sequence % keyframeInterval == 0;
+
+		*output++ = sequence++;
+		*output++ = valueCount;
+		for (uint8_t index = 0; index < valueCount; ++index)
+		{
+			const uint32_t current = values[index];
+			const uint32_t reference = keyframe ? 0 : published[index];
+			output = PutVarint( Zigzag( current - reference), output);
+			published[index] = current;
+		}
+
+		return Stuff( raw, output - raw, buffer);
+	}
+
+	/**
+	 * Consistent overhead byte stuffing: copy size bytes from input to output
+	 * so that the output contains no zero bytes and add a terminating zero.
+	 *
+	 * output must be able to hold size + size/254 + 2 bytes. Returns the
+	 * length of the output, excluding the terminating zero.
+	 */
+	uint8_t Stuff( const uint8_t *input, uint8_t size, char *output)
+	{
+		char *code = output;
+		char *current = output + 1;
+		uint8_t distance = 1;
+
+		for (const uint8_t *end = input + size; input != end; ++input)
+		{
+			if (*input)
+			{
+				*current++ = *input;
+				++distance;
+			}
+
+			if (not *input or distance == 0xff)
+			{
+				*code = distance;
+				code = current++;
+				distance = 1;
+			}
+		}
+
+		*code = distance;
+		*current = 0;
+		return current - output;
+	}
+}
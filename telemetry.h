@@ -0,0 +1,64 @@
+/*
+ * telemetry.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: agent
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+#include <stdint.h>
+
+/**
+ * Compact binary telemetry.
+ *
+ * A telemetry frame contains all values listed in Telemetry::Value. Each value
+ * is sent as the difference with the value in the previous frame, zigzag
+ * encoded and packed as a little-endian base-128 varint. Every keyframeInterval
+ * frames the values are sent as differences with zero, so that a receiver can
+ * (re)synchronize after lost frames.
+ *
+ * Frame layout before stuffing:
+ *     sequence number (1 byte), value count (1 byte), varints...
+ *
+ * The frame is then COBS-stuffed so that it contains no zero bytes and
+ * can be published as an ordinary zero-terminated MQTT message.
+ * tools/telemetry_decoder.py decodes the resulting stream.
+ */
+namespace Telemetry
+{
+	enum Value : uint8_t
+	{
+		commands,     ///< number of switch commands transmitted
+		airTime,      ///< transmit time in timer ticks
+		motionEvents, ///< number of PIR transitions
+		loopMax,      ///< longest main loop iteration in units of 4us
+		syncFailures, ///< failed attempts to synchronize with esp-link
+		linkFailures, ///< times the esp-link connection was found dead
+		time,         ///< Clock::Now() at the moment of publishing
+		rejectedSyntax,   ///< switch commands or thresholds with a malformed number
+		rejectedOverflow, ///< switch commands or thresholds with a number that is too large
+		rejectedSwitch,   ///< switch commands for a switch that doesn't exist
+		rejectedAction,   ///< switch commands with an action other than 0 or 1
+		rejectedQueueFull,///< switch commands dropped because the queue was full
+		stackMax,     ///< largest stack size seen so far in bytes
+		temperature,  ///< internal temperature sensor, 12-bit ADC value
+		compensation, ///< pulse timing correction in ppm, signed
+		rejectedThreshold, ///< light thresholds that were malformed or out of range
+		valueCount
+	};
+
+	void Add( Value value, uint16_t amount = 1);
+	void Set( Value value, uint32_t newValue);
+
+	uint8_t Encode( char *buffer);
+
+	uint8_t Stuff( const uint8_t *input, uint8_t size, char *output);
+
+	/// largest possible size of a frame, including terminating zero.
+	constexpr uint8_t maxRawSize = 2 + 5 * valueCount;
+	constexpr uint8_t maxFrameSize = maxRawSize + maxRawSize / 254 + 2;
+	constexpr uint8_t keyframeInterval = 16;
+}
+
+#endif /* TELEMETRY_H_ */
@@ -9,6 +9,8 @@
 
 #include "timer.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <avr_utilities/pin_definitions.hpp>
 
 
@@ -18,9 +20,30 @@ struct InitTimer
 	{
 		TCCR1A = 0;
 		TCCR1B = 5; // clk/1024
+		TIMSK1 = _BV( TOIE1);
+
+		TCCR2A = 0;
+		TCCR2B = _BV( CS21) | _BV( CS20); // clk/32, 4us per tick
+		TIMSK2 = _BV( TOIE2);
 	}
 } timerstarter;
 
+namespace
+{
+	volatile uint16_t overflows = 0;
+	volatile uint32_t fineOverflows = 0;
+}
+
+ISR( TIMER1_OVF_vect)
+{
+	++overflows;
+}
+
+ISR( TIMER2_OVF_vect)
+{
+	++fineOverflows;
+}
+
 namespace Timer
 {
 	uint16_t GetCurrent()
@@ -28,6 +51,106 @@ namespace Timer
 		return TCNT1;
 	}
 
+	/**
+	 * Return the 32-bit timer value, consisting of the number of timer overflows in
+	 * the high word and the current timer value in the low word.
+	 *
+	 * This clock wraps after about 6 days.
+	 */
+	uint32_t GetCurrentLong()
+	{
+		uint16_t high;
+		uint16_t low;
+		ATOMIC_BLOCK( ATOMIC_RESTORESTATE)
+		{
+			high = overflows;
+			low = TCNT1;
+
+			// an overflow may have happened that was not handled yet.
+			if ((TIFR1 & _BV( TOV1)) and low < 0x8000) ++high;
+		}
+		return (static_cast<uint32_t>( high) << 16) | low;
+	}
+
+	namespace Fine
+	{
+		uint32_t GetCurrent()
+		{
+			uint32_t high;
+			uint8_t low;
+			ATOMIC_BLOCK( ATOMIC_RESTORESTATE)
+			{
+				high = fineOverflows;
+				low = TCNT2;
+				if ((TIFR2 & _BV( TOV2)) and low < 0x80) ++high;
+			}
+			return (high << 8) | low;
+		}
+
+		bool HasPassed( uint32_t deadline)
+		{
+			return static_cast<int32_t>( GetCurrent() - deadline) >= 0;
+		}
+
+		void WaitUntil( uint32_t deadline)
+		{
+			while (not HasPassed( deadline)) /* wait */;
+		}
+
+		/**
+		 * Wait for the given number of 4us ticks. The error is less than
+		 * two ticks, independent of the duration.
+		 */
+		void Wait( uint32_t ticks)
+		{
+			WaitUntil( GetCurrent() + ticks);
+		}
+
+		namespace
+		{
+			uint32_t pausedFine;
+			uint32_t pausedCoarse;
+		}
+
+		/**
+		 * Stop the overflow interrupt and remember the current time of both clocks.
+		 */
+		void Pause()
+		{
+			ATOMIC_BLOCK( ATOMIC_RESTORESTATE)
+			{
+				pausedFine = GetCurrent();
+				pausedCoarse = GetCurrentLong();
+				TIMSK2 &= ~_BV( TOIE2);
+			}
+		}
+
+		/**
+		 * Restart the overflow interrupt after Pause().
+		 *
+		 * Both timers count the same clock, 32 fine ticks per timer 1 tick, so
+		 * timer 1 gives the elapsed time to within one of its ticks. Of all fine
+		 * times that end in the current TCNT2 value, the one closest to that
+		 * estimate is the right one.
+		 */
+		void Resume()
+		{
+			// make sure that TCNT2 doesn't overflow while the overflow flag is
+			// cleared and the counter is read, which takes a few ticks at most.
+			while (TCNT2 > 0xf8) /* wait */;
+
+			ATOMIC_BLOCK( ATOMIC_RESTORESTATE)
+			{
+				const uint32_t estimate = pausedFine + 32 * (GetCurrentLong() - pausedCoarse);
+				TIFR2 = _BV( TOV2);
+				const uint8_t low = TCNT2;
+				const uint32_t now = estimate + static_cast<int8_t>( low - static_cast<uint8_t>( estimate));
+				fineOverflows = now >> 8;
+				TIMSK2 |= _BV( TOIE2);
+			}
+		}
+	}
+
 	/**
 	 * Test if the timer has passed the wait value.
 	 *
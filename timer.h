@@ -17,12 +17,34 @@ namespace Timer
 	};
 
 	uint16_t GetCurrent();
+	uint32_t GetCurrentLong();
 	bool HasPassed( const TimerWaitValue &val);
 	bool HasPassedOnce( TimerWaitValue &val);
 	TimerWaitValue After( uint16_t ticks);
 
 	constexpr uint16_t ticksPerSecond = 7812;
 	constexpr TimerWaitValue always = {0,0};
+
+	/**
+	 * Clock with a resolution of 4us, the unit in which pulse durations and gaps
+	 * are expressed, based on timer 2.
+	 *
+	 * Deadlines are compared as signed differences, so they must lie less than
+	 * 2^31 ticks (about 2.4 hours) from the current time.
+	 *
+	 * The overflow interrupt runs every 1.024ms. Code that times itself by
+	 * counting cycles can Pause() it; Resume() recovers the overflows that were
+	 * missed from timer 1. The fine clock must not be read in between.
+	 */
+	namespace Fine
+	{
+		uint32_t GetCurrent();
+		bool HasPassed( uint32_t deadline);
+		void WaitUntil( uint32_t deadline);
+		void Wait( uint32_t ticks);
+		void Pause();
+		void Resume();
+	}
 }
 
 #endif /* TIMER_H_ */
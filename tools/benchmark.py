@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Collect benchmark figures of the firmware and compare them with a baseline.
+
+'collect' writes a JSON object with one number per metric:
+
+  * flash and sram: program memory and static RAM use, from avr-size on the
+    ELF file of a build (--elf),
+  * <protocol>.airtime_ms and <protocol>.commands_per_s: duration of one
+    command with all its repeats and the resulting command throughput, from
+    symbols[] and the repeat count in remotes.cpp,
+  * <name>.min/avg/max: statistics published by a node on spider/stats/<name>,
+    for instance loop latency, saved to a file with
+    mosquitto_sub -C 1 -t spider/stats/loop > loop.txt  (--stats loop=loop.txt).
+
+With --history, the results are also appended to a JSON lines file together
+with the git revision and the date, which keeps a record over time.
+
+'compare' reads a baseline and a current result and reports every metric that
+got worse by more than its threshold. It exits with status 1 if there was any
+regression, so it can be used in scripts. Everything runs locally.
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from reception_model import air_time, parse_symbols  # noqa: E402
+
+# metrics for which a higher value is better, by suffix.
+HIGHER_IS_BETTER = (".commands_per_s",)
+
+DEFAULT_THRESHOLD = 0.05
+
+
+def memory_use(elf, size_tool):
+    """Return flash and static RAM use of an ELF file in bytes."""
+    output = subprocess.run([size_tool, "-A", elf], check=True,
+                            stdout=subprocess.PIPE, universal_newlines=True).stdout
+    sections = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sections[fields[0]] = int(fields[1])
+    text = sections.get(".text", 0)
+    data = sections.get(".data", 0)
+    bss = sections.get(".bss", 0) + sections.get(".noinit", 0)
+    return {"flash": text + data, "sram": data + bss}
+
+
+def transmission_figures(source):
+    """Return air time and throughput of every protocol in remotes.cpp."""
+    match = re.search(r"transmission\.repeats\s*=\s*(\d+)", source)
+    repeats = int(match.group(1)) if match else 12
+    figures = {}
+    for encoding in parse_symbols(source):
+        milliseconds = air_time(encoding, repeats, 1.0)
+        figures[encoding.name + ".airtime_ms"] = round(milliseconds, 2)
+        figures[encoding.name + ".commands_per_s"] = round(1000.0 / milliseconds, 3)
+    return figures
+
+
+def node_statistics(name, path):
+    """Parse the text that a node publishes on spider/stats/<name>: minimum,
+    average, maximum and count; the histogram is published separately."""
+    with open(path) as stats:
+        fields = stats.read().split()
+    if len(fields) < 3:
+        raise ValueError("{}: expected at least minimum, average and maximum".format(path))
+    return {name + ".min": int(fields[0]), name + ".avg": int(fields[1]), name + ".max": int(fields[2])}
+
+
+def git_revision(directory):
+    try:
+        return subprocess.run(["git", "-C", directory, "describe", "--always", "--dirty"], check=True,
+                              stdout=subprocess.PIPE, universal_newlines=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def collect(arguments):
+    with open(arguments.source) as source:
+        results = transmission_figures(source.read())
+    if arguments.elf:
+        results.update(memory_use(arguments.elf, arguments.size_tool))
+    for stats in arguments.stats or []:
+        name, _, path = stats.partition("=")
+        results.update(node_statistics(name, path))
+
+    text = json.dumps(results, indent=2, sort_keys=True)
+    if arguments.output:
+        with open(arguments.output, "w") as output:
+            output.write(text + "\n")
+    else:
+        print(text)
+
+    if arguments.history:
+        record = {
+            "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+            "revision": git_revision(os.path.dirname(os.path.abspath(arguments.source))),
+            "results": results,
+        }
+        with open(arguments.history, "a") as history:
+            history.write(json.dumps(record, sort_keys=True) + "\n")
+
+
+def load(path):
+    """Load results, either a plain result file or the last record of a
+    history file."""
+    with open(path) as source:
+        lines = [line for line in source.read().splitlines() if line.strip()]
+    try:
+        results = json.loads("\n".join(lines))
+    except ValueError:
+        results = json.loads(lines[-1])
+    return results.get("results", results)
+
+
+def thresholds(specifications):
+    result = {}
+    for specification in specifications or []:
+        metric, _, value = specification.partition("=")
+        result[metric] = float(value) / 100
+    return result
+
+
+def compare(arguments):
+    baseline = load(arguments.baseline)
+    current = load(arguments.current)
+    limits = thresholds(arguments.threshold)
+    default = arguments.default_threshold / 100
+
+    regressions = 0
+    for metric in sorted(set(baseline) | set(current)):
+        if metric not in baseline or metric not in current:
+            print("{:<32} {}".format(metric, "new" if metric in current else "removed"))
+            continue
+        old, new = baseline[metric], current[metric]
+        change = (new - old) / old if old else (0.0 if new == old else float("inf"))
+        worse = -change if metric.endswith(HIGHER_IS_BETTER) else change
+        limit = limits.get(metric, default)
+        status = "REGRESSION" if worse > limit else ("improved" if worse < 0 else "ok")
+        if worse > limit:
+            regressions += 1
+        if status != "ok" or arguments.verbose:
+            print("{:<32} {:>12} -> {:<12} {:+7.1%}  {}".format(metric, old, new, change, status))
+    print("{} regression{}".format(regressions, "" if regressions == 1 else "s"))
+    return 1 if regressions else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command")
+    commands.required = True
+
+    collecting = commands.add_parser("collect", help="collect the current figures")
+    collecting.add_argument("--source", default="remotes.cpp", help="firmware source with symbols[]")
+    collecting.add_argument("--elf", help="ELF file of a build, for flash and SRAM use")
+    collecting.add_argument("--size-tool", default="avr-size")
+    collecting.add_argument("--stats", action="append", metavar="NAME=FILE",
+                            help="statistics published by a node, may be repeated")
+    collecting.add_argument("--output", help="result file (default: standard output)")
+    collecting.add_argument("--history", help="JSON lines file to append the results to")
+
+    comparing = commands.add_parser("compare", help="compare results with a baseline")
+    comparing.add_argument("baseline", help="result file or history file (last record)")
+    comparing.add_argument("current", help="result file or history file (last record)")
+    comparing.add_argument("--threshold", action="append", metavar="METRIC=PERCENT",
+                           help="allowed regression of a metric, may be repeated")
+    comparing.add_argument("--default-threshold", type=float, default=DEFAULT_THRESHOLD * 100,
+                           help="allowed regression in percent of other metrics (default: 5)")
+    comparing.add_argument("--verbose", action="store_true", help="also list unchanged metrics")
+
+    arguments = parser.parse_args()
+    if arguments.command == "collect":
+        collect(arguments)
+    else:
+        sys.exit(compare(arguments))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,324 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Derive an Encoding entry for remotes.cpp from captured pulse trains.
+
+The input is a capture of a remote control that repeats its code several
+times, as alternating high and low durations in microseconds, starting with a
+high level. Numbers may be separated by commas or white space and spread over
+any number of lines. Lines starting with ';' or '#' are comments, except for
+';timescale <n>us', so rtl_433 OOK pulse files (rtl_433 -w capture.ook) can
+be used as they are. Signed durations (+high, -low) are accepted as well.
+
+The capture is cut into repeats at the long low levels. The pulse widths are
+clustered, after which every possible start of the frame within a repeat and
+every preamble length is tried. The candidate in which the most bits are one
+of the two most common symbols wins. Pulse widths are the medians over all
+repeats, so thousands of captured frames average out the noise.
+
+The symbol whose first level is the shortest is taken as the 0 bit. If the
+remote turns out to use the opposite convention, swap the two symbols and
+invert the codes. Bits are numbered in the order in which they are sent,
+which is the order in which send_command_once() sends them: least
+significant bit first.
+"""
+
+import argparse
+import bisect
+import collections
+import math
+import re
+import statistics
+import sys
+
+
+def read_durations(lines, scale=1.0):
+    """Return the list of level durations in microseconds.
+
+    Consecutive durations of the same level, which only occur with signed
+    input, are merged.
+    """
+    durations = []
+    signed = False
+    for line in lines:
+        line = line.strip()
+        if line.startswith(";") or line.startswith("#"):
+            match = re.match(r";timescale\s+([\d.]+)\s*(us|ms|ns)?", line)
+            if match:
+                factor = {"ms": 1000.0, "ns": 0.001}.get(match.group(2), 1.0)
+                scale = float(match.group(1)) * factor
+            continue
+        for field in re.split(r"[\s,]+", line):
+            if not field:
+                continue
+            value = float(field)
+            if field[0] in "+-":
+                signed = True
+            durations.append(value)
+
+    if not signed:
+        return [abs(d) * scale for d in durations]
+
+    # with signed input, rebuild strictly alternating levels starting high.
+    merged = []
+    levels = []
+    for value in durations:
+        level = value > 0
+        if levels and levels[-1] == level:
+            merged[-1] += abs(value) * scale
+        elif not levels and not level:
+            continue
+        else:
+            merged.append(abs(value) * scale)
+            levels.append(level)
+    return merged
+
+
+def clusters(durations, width=0.06, noise=0.002):
+    """Cluster durations on a logarithmic scale.
+
+    Returns a list of (lower, upper) bounds of the clusters. Histogram bins
+    that hold less than the noise fraction of all durations separate clusters.
+    """
+    histogram = collections.Counter(int(math.log(d) / width) for d in durations if d > 0)
+    floor = max(1, noise * len(durations))
+    bounds = []
+    for bin_ in sorted(histogram):
+        if histogram[bin_] < floor:
+            continue
+        lower = math.exp(bin_ * width)
+        upper = math.exp((bin_ + 1) * width)
+        if bounds and abs(bounds[-1][1] - lower) < 1e-9 * upper:
+            bounds[-1] = (bounds[-1][0], upper)
+        else:
+            bounds.append((lower, upper))
+    return bounds
+
+
+def classifier(bounds):
+    """Return a function that maps a duration to the index of its cluster.
+
+    Durations between clusters go to the closest one on a logarithmic scale.
+    """
+    centers = [math.sqrt(lower * upper) for lower, upper in bounds]
+    limits = [math.sqrt(a * b) for a, b in zip(centers, centers[1:])]
+
+    def classify(duration):
+        return bisect.bisect(limits, duration)
+    return classify
+
+
+def repeats(durations):
+    """Cut the capture into repeats: each repeat consists of the levels up to
+    and including a long low level. Returns the repeats that have the most
+    common length and the number of repeats that were discarded."""
+    ordered = sorted(durations)
+    threshold = 4 * ordered[int(0.9 * (len(ordered) - 1))]
+    cut = []
+    current = []
+    for index, duration in enumerate(durations):
+        current.append(duration)
+        if index % 2 and duration >= threshold:
+            cut.append(current)
+            current = []
+
+    # the first repeat probably started before the capture did.
+    cut = cut[1:]
+    if not cut:
+        return [], 0
+    length = collections.Counter(len(r) for r in cut).most_common(1)[0][0]
+    kept = [r for r in cut if len(r) == length]
+    return kept, len(cut) - len(kept)
+
+
+class Candidate:
+    """One interpretation of a repeat: where the frame starts and how many
+    of its first levels form the preamble."""
+
+    def __init__(self, rotation, preamble):
+        self.rotation = rotation
+        self.preamble = preamble
+
+    def frame(self, repeat):
+        return repeat[self.rotation:] + repeat[:self.rotation]
+
+    def pairs(self, repeat):
+        """Split the frame into the preamble, the symbol pairs and the gap.
+
+        Without preamble or with a high and a low preamble level the frame
+        starts with a high symbol level and the low level of the last symbol
+        merges with the gap, so the last pair is (high, low + gap). With a
+        single high preamble level the symbols start low and the gap is the
+        last level on its own.
+        """
+        frame = self.frame(repeat)
+        body = frame[self.preamble:]
+        if self.preamble == 1:
+            return frame[:1], [tuple(body[i:i + 2]) for i in range(0, len(body) - 1, 2)], body[-1]
+        return frame[:self.preamble], [tuple(body[i:i + 2]) for i in range(0, len(body), 2)], None
+
+    def score(self, sample, classify):
+        """Fraction of the symbols that is one of the two most common ones."""
+        types = collections.Counter()
+        merged_firsts = collections.Counter()
+        total = 0
+        for repeat in sample:
+            _, pairs, gap = self.pairs(repeat)
+            if gap is None:
+                merged_firsts[classify(pairs[-1][0])] += 1
+                pairs = pairs[:-1]
+            types.update((classify(a), classify(b)) for a, b in pairs)
+            total += len(pairs)
+        if not total:
+            return 0.0, []
+        alphabet = [t for t, _ in types.most_common(2)]
+        conforming = sum(types[t] for t in alphabet)
+        if merged_firsts:
+            firsts = {t[0] for t in alphabet}
+            conforming += sum(n for c, n in merged_firsts.items() if c in firsts)
+            total += sum(merged_firsts.values())
+        return conforming / total, alphabet
+
+
+def infer(repeats_, classify, sample_size=200):
+    """Find the best candidate and its alphabet as pairs of cluster indices."""
+    sample = repeats_[:sample_size]
+    length = len(sample[0])
+    best = None
+    for rotation in range(0, length, 2):
+        for preamble in (0, 1, 2):
+            if length - preamble < 4:
+                continue
+            candidate = Candidate(rotation, preamble)
+            score, alphabet = candidate.score(sample, classify)
+            if len(alphabet) < 2:
+                continue
+            # prefer the simplest interpretation among equally good ones.
+            key = (round(score, 3), -preamble, -rotation)
+            if best is None or key > best[0]:
+                best = (key, candidate, alphabet, score)
+    if best is None:
+        raise ValueError("no consistent two-symbol encoding found")
+    return best[1], best[2], best[3]
+
+
+def decode(repeats_, candidate, alphabet, classify):
+    """Decode all repeats. Returns the codes with their counts, the observed
+    durations of each part of the encoding and the number of repeats that
+    contained a symbol outside the alphabet."""
+    # the 0 symbol is the one that starts with the shorter level.
+    alphabet = sorted(alphabet)
+    firsts = [t[0] for t in alphabet]
+    ambiguous = firsts[0] == firsts[1]
+
+    codes = collections.Counter()
+    widths = {"symbol": [[[], []], [[], []]], "preamble": [[], []], "gap": []}
+    rejected = 0
+    for repeat in repeats_:
+        preamble, pairs, gap = candidate.pairs(repeat)
+        merged = gap is None
+        value = 0
+        valid = True
+        for bit, (first, second) in enumerate(pairs):
+            last = merged and bit == len(pairs) - 1
+            if last:
+                kind = (classify(first), None)
+                symbol = 1 if (not ambiguous and kind[0] == firsts[1]) else 0
+            else:
+                kind = (classify(first), classify(second))
+                if kind not in alphabet:
+                    valid = False
+                    break
+                symbol = alphabet.index(kind)
+            value |= symbol << bit
+            widths["symbol"][symbol][0].append(first)
+            if not last:
+                widths["symbol"][symbol][1].append(second)
+            else:
+                gap = (second, symbol)
+        if not valid:
+            rejected += 1
+            continue
+        codes[(value, len(pairs))] += 1
+        for index, level in enumerate(preamble):
+            widths["preamble"][index].append(level)
+        widths["gap"].append(gap)
+    return codes, widths, rejected, ambiguous
+
+
+def us4(durations):
+    return int(round(statistics.median(durations) / 4)) if durations else 0
+
+
+def encoding(candidate, widths):
+    """Build the Encoding fields, in units of 4us."""
+    symbol = [[us4(level) for level in widths["symbol"][s]] for s in (0, 1)]
+    gaps = []
+    for gap in widths["gap"]:
+        if isinstance(gap, tuple):
+            # the low level of the last symbol merged with the gap.
+            merged, last = gap
+            gaps.append(merged - symbol[last][1] * 4)
+        else:
+            gaps.append(gap)
+    start_high = us4(widths["preamble"][0]) if candidate.preamble >= 1 else 0
+    start_low = us4(widths["preamble"][1]) if candidate.preamble == 2 else 0
+    return max(1, us4(gaps)), start_high, start_low, symbol
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="pulse capture (default: standard input)")
+    parser.add_argument("--scale", type=float, default=1.0,
+                        help="microseconds per unit in the capture (default: 1)")
+    parser.add_argument("--name", default="new protocol", help="name for the comment above the entry")
+    parser.add_argument("--codes", type=int, default=10, help="number of decoded codes to list")
+    arguments = parser.parse_args()
+
+    with (open(arguments.capture) if arguments.capture else sys.stdin) as source:
+        durations = read_durations(source, arguments.scale)
+    if len(durations) < 10:
+        sys.exit("capture too short")
+
+    repeats_, discarded = repeats(durations)
+    if not repeats_:
+        sys.exit("no repeated frames found, is the capture long enough?")
+
+    bounds = clusters([d for r in repeats_ for d in r[:-1]])
+    classify = classifier(bounds)
+    try:
+        candidate, alphabet, score = infer(repeats_, classify)
+    except ValueError as error:
+        sys.exit(str(error))
+
+    codes, widths, rejected, ambiguous = decode(repeats_, candidate, alphabet, classify)
+    if not codes:
+        sys.exit("no frame could be decoded")
+    bits = collections.Counter(b for _, b in codes.elements()).most_common(1)[0][0]
+    gap, start_high, start_low, symbol = encoding(candidate, widths)
+
+    print("// {} repeats used, {} with an unexpected length, {} with unknown symbols; "
+          "{:.1%} of the symbols fit".format(len(repeats_), discarded, rejected, score))
+    print("// pulse width clusters (us): {}".format(
+        ", ".join("{:.0f}-{:.0f}".format(lower, upper) for lower, upper in bounds)))
+    if ambiguous:
+        print("// warning: both symbols start with the same level, the last bit of "
+              "each code is a guess")
+    print()
+    print("    // {}".format(arguments.name))
+    print("    {{ {},{}{},{}{}, {}, {{ {{ {}, {} }}, {{ {}, {} }} }} }},".format(
+        gap, " " * max(1, 9 - len(str(gap))), bits, " " * max(1, 7 - len(str(bits))),
+        start_high, start_low, symbol[0][0], symbol[0][1], symbol[1][0], symbol[1][1]))
+    print()
+    print("// decoded codes (count, value as written in switches[])")
+    for (value, length), count in codes.most_common(arguments.codes):
+        print("// {:6d}  0b{:0{}b}".format(count, value, length))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Estimate how many repeats each protocol needs to be received reliably.
+
+The encodings are read from the symbols[] table in remotes.cpp and the codes
+from switches[]. For every encoding, transmissions are generated level by
+level in the same way as send_command_once() and transmit_queued() do, passed
+through a model of the radio channel and fed to a model of the receiver in a
+switch. Repeating this many times gives the probability that a switch
+receives its command as a function of the number of repeats. The recommended
+repeat count is the smallest one that reaches the target reliability.
+
+Channel model, per transmitted level:
+  * the receiver stretches high levels and shortens low levels by --skew us,
+  * every level gets gaussian timing jitter of --jitter us,
+  * noise bursts of 20-150us arrive at --noise per second, also in the gaps,
+  * levels disappear with probability --lost, merging with their neighbours,
+  * whole repeats fade out with probability --fade.
+
+Receiver model: after a low level of at least --sync times the longest symbol
+level, the receiver tries to decode a frame. Like in common receiver
+libraries, every level must be within --tolerance times the shortest symbol
+level of its nominal width; the low level of the last symbol only needs
+to be long enough, because it merges with the gap. A command is accepted once
+--matches frames have been decoded correctly.
+
+Since a frame only depends on the levels since the preceding sync, one
+simulated transmission of the maximum number of repeats yields the outcome for
+every smaller repeat count as well.
+"""
+
+import argparse
+import random
+import re
+import sys
+from collections import namedtuple
+
+Encoding = namedtuple("Encoding", "name gap bits start_high start_low alphabet")
+
+US_PER_UNIT = 4
+
+
+def parse_symbols(source):
+    """Return the encodings in the symbols[] table of remotes.cpp."""
+    table = re.search(r"Encoding\s+symbols\[\]\s*=\s*\{(.*?)\n\};", source, re.S)
+    if not table:
+        raise ValueError("symbols[] table not found")
+    encodings = []
+    name = None
+    for line in table.group(1).splitlines():
+        comment = re.match(r"\s*//\s*(\w+)", line)
+        if comment:
+            name = comment.group(1)
+            continue
+        numbers = [int(n) for n in re.findall(r"\d+", line.split("//")[0])]
+        if len(numbers) == 8:
+            gap, bits, start_high, start_low = numbers[:4]
+            alphabet = ((numbers[4], numbers[5]), (numbers[6], numbers[7]))
+            encodings.append(Encoding(name or "protocol{}".format(len(encodings)),
+                                      gap, bits, start_high, start_low, alphabet))
+            name = None
+    return encodings
+
+
+def parse_codes(source):
+    """Return the first 'off' code of every encoding name in switches[]."""
+    codes = {}
+    for name, code in re.findall(r"\{\s*(\w+)\s*,\s*\{\s*0b([01]+)", source):
+        codes.setdefault(name, int(code, 2))
+    return codes
+
+
+def transmission(encoding, code, repeats, gap_scale):
+    """Return the levels (high, duration in us, repeat index) of a command,
+    the way the firmware sends it. The transmission is preceded by idle time."""
+    levels = [[False, 100000.0, -1]]
+
+    def add(high, units, repeat):
+        duration = units * US_PER_UNIT
+        if levels[-1][0] == high:
+            levels[-1][1] += duration
+        else:
+            levels.append([high, duration, repeat])
+
+    gap = max(1, round(encoding.gap * gap_scale))
+    for repeat in range(repeats):
+        pin = False
+        if encoding.start_high:
+            pin = True
+            add(pin, encoding.start_high, repeat)
+        if encoding.start_low:
+            pin = False
+            add(pin, encoding.start_low, repeat)
+        value = code
+        for _ in range(encoding.bits):
+            high, low = encoding.alphabet[value & 1]
+            pin = not pin
+            add(pin, high, repeat)
+            pin = not pin
+            add(pin, low, repeat)
+            value >>= 1
+        add(False, gap, repeat)
+    add(False, 25000, repeats)
+    return levels
+
+
+def impair(levels, arguments, rng):
+    """Apply the channel model to a list of levels."""
+    faded = set(r for r in range(max(l[2] for l in levels) + 1) if rng.random() < arguments.fade)
+    result = []
+
+    def append(high, duration, repeat):
+        if result and result[-1][0] == high:
+            result[-1][1] += duration
+        else:
+            result.append([high, duration, repeat])
+
+    for high, duration, repeat in levels:
+        if repeat in faded:
+            high = False
+        if rng.random() < arguments.lost:
+            # the level disappears into the surrounding ones.
+            append(not high, duration, repeat)
+            continue
+        duration += (arguments.skew if high else -arguments.skew) + rng.gauss(0, arguments.jitter)
+        duration = max(duration, 1.0)
+
+        # split the level by noise bursts.
+        while True:
+            burst_at = rng.expovariate(arguments.noise / 1e6) if arguments.noise else float("inf")
+            if burst_at >= duration:
+                append(high, duration, repeat)
+                break
+            burst = rng.uniform(20, 150)
+            append(high, burst_at, repeat)
+            append(not high, burst, repeat)
+            duration -= burst_at + burst
+            if duration <= 0:
+                break
+    return result
+
+
+class Receiver:
+    """Frame decoder of a switch for one encoding."""
+
+    def __init__(self, encoding, arguments):
+        self.encoding = encoding
+        longest = max(max(symbol) for symbol in encoding.alphabet) * US_PER_UNIT
+        self.tolerance = arguments.tolerance * min(min(symbol) for symbol in encoding.alphabet) * US_PER_UNIT
+        self.sync = arguments.sync * longest
+
+        # the levels that follow the sync: a preamble high if the preamble
+        # has no low part, then the symbols.
+        self.preamble = []
+        if encoding.start_high and not encoding.start_low:
+            self.preamble = [encoding.start_high * US_PER_UNIT]
+
+    def fits(self, duration, nominal):
+        return abs(duration - nominal) <= self.tolerance
+
+    def decode(self, levels, start):
+        """Decode a frame from the levels starting at index start. Returns the
+        code or None."""
+        index = start
+        for nominal in self.preamble:
+            if index >= len(levels) or not self.fits(levels[index][1], nominal):
+                return None
+            index += 1
+
+        value = 0
+        bits = self.encoding.bits
+        if index + 2 * bits > len(levels):
+            return None
+        for bit in range(bits):
+            first = levels[index][1]
+            second = levels[index + 1][1]
+            index += 2
+            last = bit == bits - 1
+            symbol = None
+            for candidate, (high, low) in enumerate(self.encoding.alphabet):
+                if not self.fits(first, high * US_PER_UNIT):
+                    continue
+                if last and not levels[index - 1][0]:
+                    # the low level of the last symbol merges with the gap.
+                    if second < low * US_PER_UNIT - self.tolerance:
+                        continue
+                elif not self.fits(second, low * US_PER_UNIT):
+                    continue
+                symbol = candidate
+                break
+            if symbol is None:
+                return None
+            value |= symbol << bit
+        return value
+
+    def frames(self, levels):
+        """Yield (repeat index, code) for every frame that decodes."""
+        for index in range(len(levels) - 1):
+            high, duration, _ = levels[index]
+            if high or duration < self.sync:
+                continue
+            code = self.decode(levels, index + 1)
+            if code is not None:
+                yield levels[index + 1][2], code
+
+
+def simulate(encoding, code, gap_scale, arguments, rng):
+    """Return, for every repeat count from 1 to --max-repeats, the fraction
+    of transmissions that were accepted."""
+    receiver = Receiver(encoding, arguments)
+    accepted = [0] * (arguments.max_repeats + 1)
+    for _ in range(arguments.trials):
+        levels = impair(transmission(encoding, code, arguments.max_repeats, gap_scale), arguments, rng)
+        good = sorted(repeat for repeat, decoded in receiver.frames(levels) if decoded == code)
+        if len(good) >= arguments.matches:
+            # the command is accepted during the repeat that completes the
+            # required number of good frames.
+            accepted[good[arguments.matches - 1] + 1] += 1
+    result = []
+    total = 0
+    for repeats in range(1, arguments.max_repeats + 1):
+        total += accepted[repeats]
+        result.append(total / arguments.trials)
+    return result
+
+
+def air_time(encoding, repeats, gap_scale):
+    """Transmission time in milliseconds of a command with the given number
+    of repeats."""
+    symbols = sum(sum(symbol) for symbol in encoding.alphabet) / 2 * encoding.bits
+    frame = encoding.start_high + encoding.start_low + symbols + max(1, round(encoding.gap * gap_scale))
+    return repeats * frame * US_PER_UNIT / 1000.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--source", default="remotes.cpp", help="firmware source with symbols[] and switches[]")
+    parser.add_argument("--trials", type=int, default=1000, help="simulated transmissions per setting")
+    parser.add_argument("--target", type=float, default=0.999, help="required probability of reception")
+    parser.add_argument("--max-repeats", type=int, default=12, help="largest repeat count to consider")
+    parser.add_argument("--gap-scale", type=float, action="append",
+                        help="gap length relative to symbols[], may be repeated (default: 0.5, 1 and 2)")
+    parser.add_argument("--tolerance", type=float, default=0.6,
+                        help="receiver pulse width tolerance, relative to the shortest symbol level")
+    parser.add_argument("--sync", type=float, default=4.0, help="sync length in longest symbol levels")
+    parser.add_argument("--matches", type=int, default=1, help="good frames a receiver needs")
+    parser.add_argument("--skew", type=float, default=30.0, help="receiver high level stretch in us")
+    parser.add_argument("--jitter", type=float, default=20.0, help="timing jitter in us")
+    parser.add_argument("--noise", type=float, default=5.0, help="noise bursts per second")
+    parser.add_argument("--lost", type=float, default=0.002, help="probability that a level is lost")
+    parser.add_argument("--fade", type=float, default=0.05, help="probability that a repeat fades out")
+    parser.add_argument("--seed", type=int, default=1)
+    arguments = parser.parse_args()
+    gap_scales = arguments.gap_scale or [0.5, 1.0, 2.0]
+    rng = random.Random(arguments.seed)
+
+    with open(arguments.source) as source:
+        text = source.read()
+    encodings = parse_symbols(text)
+    codes = parse_codes(text)
+
+    print("{:<14} {:>5}  {}  {:>8} {:>9}".format(
+        "protocol", "gap", " ".join("{:>5}".format(r) for r in range(1, arguments.max_repeats + 1)),
+        "repeats", "air (ms)"))
+    for encoding in encodings:
+        code = codes.get(encoding.name, int("01" * encoding.bits, 2) & ((1 << encoding.bits) - 1))
+        best = None
+        for gap_scale in gap_scales:
+            probabilities = simulate(encoding, code, gap_scale, arguments, rng)
+            needed = next((r for r, p in enumerate(probabilities, 1) if p >= arguments.target), None)
+            time = air_time(encoding, needed, gap_scale) if needed else None
+            print("{:<14} {:>5.2f}  {}  {:>8} {:>9}".format(
+                encoding.name, gap_scale, " ".join("{:5.3f}".format(p) for p in probabilities),
+                needed or "-", "{:.1f}".format(time) if time else "-"))
+            if time and (best is None or time < best[0]):
+                best = (time, needed, gap_scale)
+        current = air_time(encoding, 12, 1.0)
+        if best:
+            print("{:<14} recommended: {} repeats with gap x{:.2f}, {:.1f}ms instead of {:.1f}ms".format(
+                encoding.name, best[1], best[2], best[0], current))
+        else:
+            print("{:<14} no setting reaches {}".format(encoding.name, arguments.target))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
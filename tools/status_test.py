@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Check the online status of a node against a local MQTT broker.
+
+Subscribes to <base>status with mosquitto_sub and checks, in this order:
+
+  1. that the broker holds a retained "online" for a running node,
+  2. that the node publishes "offline" when it is sent "update" on
+     <base>firmware, and "online" again once the bootloader has given up
+     waiting for the update tool and the application has reconnected,
+  3. that the broker publishes the last will, "offline", after the link of
+     the node is cut. The script asks the operator to cut it, for instance
+     by switching off the ESP8266 or its access point.
+
+esp-link only sends the last will that the node registers when it connects
+to the broker, so check 3 fails if esp-link has not reconnected since the
+node started. Restart the broker or the access point once before running
+this script to be sure. The broker notices a lost connection only after 1.5
+times the keepalive time configured in esp-link, which --lwt-timeout must
+allow for.
+
+Requires mosquitto_sub and mosquitto_pub. Exits with status 1 if any check
+fails.
+"""
+
+import argparse
+import queue
+import subprocess
+import sys
+import threading
+import time
+
+
+class Subscription:
+    """Messages on a topic, received by a mosquitto_sub process."""
+
+    def __init__(self, arguments, topic):
+        # %r is the retain flag, %p the payload.
+        self.process = subprocess.Popen(
+            ["mosquitto_sub", "-h", arguments.host, "-p", str(arguments.port),
+             "-t", topic, "-F", "%r %p"],
+            stdout=subprocess.PIPE, universal_newlines=True)
+        self.messages = queue.Queue()
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self):
+        for line in self.process.stdout:
+            retained, _, payload = line.rstrip("\n").partition(" ")
+            self.messages.put((payload, retained == "1"))
+
+    def expect(self, payload, timeout, retained=None):
+        """Wait for a message with the given payload and, if retained is not
+        None, the given retain flag. Other messages are skipped."""
+        deadline = time.monotonic() + timeout
+        while True:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return False
+            try:
+                message = self.messages.get(timeout=remaining)
+            except queue.Empty:
+                return False
+            print("    received {!r}{}".format(message[0], " (retained)" if message[1] else ""))
+            if message[0] == payload and (retained is None or message[1] == retained):
+                return True
+
+    def skip(self):
+        """Forget the messages received so far."""
+        while not self.messages.empty():
+            self.messages.get()
+
+    def close(self):
+        self.process.terminate()
+        self.process.wait()
+
+
+def publish(arguments, topic, message):
+    subprocess.run(["mosquitto_pub", "-h", arguments.host, "-p", str(arguments.port),
+                    "-t", topic, "-m", message], check=True)
+
+
+def report(name, passed):
+    print("{}: {}".format("PASS" if passed else "FAIL", name))
+    return passed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="localhost", help="MQTT broker")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--base", default="spider/", help="MQTT base name of the node")
+    parser.add_argument("--timeout", type=float, default=10,
+                        help="seconds to wait for the retained and the deliberate status")
+    parser.add_argument("--restart-timeout", type=float, default=60,
+                        help="seconds to wait for the node to come back after the bootloader")
+    parser.add_argument("--lwt-timeout", type=float, default=180,
+                        help="seconds to wait for the last will after the link was cut")
+    parser.add_argument("--skip-lwt", action="store_true",
+                        help="don't ask the operator to cut the link")
+    arguments = parser.parse_args()
+
+    status = Subscription(arguments, arguments.base + "status")
+    results = []
+    try:
+        print("1. retained status")
+        results.append(report("retained online",
+                              status.expect("online", arguments.timeout, retained=True)))
+
+        print("2. firmware update request")
+        status.skip()
+        publish(arguments, arguments.base + "firmware", "update")
+        results.append(report("offline before the bootloader",
+                              status.expect("offline", arguments.timeout, retained=False)))
+        results.append(report("online after the bootloader",
+                              status.expect("online", arguments.restart_timeout, retained=False)))
+
+        if not arguments.skip_lwt:
+            print("3. last will")
+            input("Cut the link of the node now (e.g. switch off the ESP8266) and press enter. ")
+            status.skip()
+            results.append(report("last will after the link was cut",
+                                  status.expect("offline", arguments.lwt_timeout, retained=False)))
+    finally:
+        status.close()
+
+    return 0 if all(results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Decode the binary telemetry frames that the node publishes on spider/telemetry.
+
+Frames are read as hexadecimal strings, one per line, which is what
+mosquitto_sub produces with the %x format:
+
+    mosquitto_sub -t spider/telemetry -F %x | tools/telemetry_decoder.py
+
+See telemetry.h for the frame layout. The value names below must be kept in
+the same order as the Telemetry::Value enumeration.
+
+With --history, the input is the command history that the node publishes on
+spider/stats/history after a request on spider/debug/history, see history.h:
+
+    mosquitto_sub -t spider/stats/history -F %x | tools/telemetry_decoder.py --history
+"""
+
+import struct
+import sys
+
+VALUE_NAMES = [
+    "commands",
+    "air_time",
+    "motion_events",
+    "loop_max",
+    "sync_failures",
+    "link_failures",
+    "time",
+    "rejected_syntax",
+    "rejected_overflow",
+    "rejected_switch",
+    "rejected_action",
+    "rejected_queue_full",
+    "stack_max",
+    "temperature",
+    "compensation_ppm",
+    "rejected_threshold",
+]
+
+# values that the node sends as signed 32-bit numbers.
+SIGNED_NAMES = {"compensation_ppm"}
+
+KEYFRAME_INTERVAL = 16
+
+# History::Status
+HISTORY_STATUS = ["queued", "sent", "invalid", "dropped"]
+
+HISTORY_ENTRY = struct.Struct("<IBBBBBH")
+
+
+def unstuff(data):
+    """Undo the consistent overhead byte stuffing applied by Telemetry::Stuff()."""
+    output = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0:
+            raise ValueError("zero byte in stuffed frame")
+        block = data[index + 1:index + code]
+        if len(block) != code - 1:
+            raise ValueError("truncated frame")
+        output += block
+        index += code
+        if code != 0xff and index < len(data):
+            output.append(0)
+    return bytes(output)
+
+
+def varints(data):
+    """Yield the unsigned base-128 varints in data."""
+    value = 0
+    shift = 0
+    for byte in data:
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            yield value
+            value = 0
+            shift = 0
+    if shift:
+        raise ValueError("truncated varint")
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+class Decoder:
+    """Reconstructs absolute values from a stream of delta encoded frames."""
+
+    def __init__(self):
+        self.values = None
+        self.expected_sequence = None
+        self.lost = 0
+
+    def decode(self, frame):
+        raw = unstuff(frame)
+        if len(raw) < 2:
+            raise ValueError("frame too short")
+        sequence, count = raw[0], raw[1]
+        deltas = [unzigzag(v) for v in varints(raw[2:])]
+        if len(deltas) != count:
+            raise ValueError("expected {} values, got {}".format(count, len(deltas)))
+
+        if self.expected_sequence is not None and sequence != self.expected_sequence:
+            self.lost += (sequence - self.expected_sequence) % 256
+            self.values = None
+        self.expected_sequence = (sequence + 1) % 256
+
+        if sequence % KEYFRAME_INTERVAL == 0:
+            self.values = [0] * count
+        if self.values is None or len(self.values) != count:
+            # no keyframe seen yet since the last lost frame.
+            self.values = None
+            return sequence, None
+
+        self.values = [(v + d) & 0xffffffff for v, d in zip(self.values, deltas)]
+        return sequence, {name: signed(value) if name in SIGNED_NAMES else value
+                          for name, value in zip(names(count), self.values)}
+
+
+def signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def names(count):
+    return VALUE_NAMES[:count] + [
+        "value{}".format(i) for i in range(len(VALUE_NAMES), count)]
+
+
+def decode_history(frame):
+    """Return the time of the dump and the list of history entries, oldest
+    first, as dictionaries."""
+    raw = unstuff(frame)
+    if len(raw) < 5:
+        raise ValueError("batch too short")
+    count = raw[0]
+    now, = struct.unpack_from("<I", raw, 1)
+    if len(raw) != 5 + count * HISTORY_ENTRY.size:
+        raise ValueError("expected {} entries, got {} bytes".format(count, len(raw)))
+    entries = []
+    for index in range(count):
+        time, source, switch, action, status, repeats, latency = \
+            HISTORY_ENTRY.unpack_from(raw, 5 + index * HISTORY_ENTRY.size)
+        entries.append({
+            "age_ms": (now - time) & 0xffffffff,
+            "topic_hash": "{:02x}".format(source),
+            "switch": "?" if switch == 0xff else switch,
+            "action": "?" if action == 0xff else action,
+            "status": HISTORY_STATUS[status] if status < len(HISTORY_STATUS) else status,
+            "repeats": repeats,
+            "latency_ms": latency * 128 / 1000.0,
+        })
+    return now, entries
+
+
+def print_history(line):
+    now, entries = decode_history(bytes.fromhex(line))
+    print("history at {}".format(now))
+    for entry in entries:
+        print("  " + " ".join("{}={}".format(k, v) for k, v in entry.items()))
+
+
+def main():
+    history = sys.argv[1:] == ["--history"]
+    decoder = Decoder()
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        if history:
+            try:
+                print_history(line)
+            except ValueError as error:
+                print("bad batch {}: {}".format(line, error), file=sys.stderr)
+            sys.stdout.flush()
+            continue
+        try:
+            sequence, values = decoder.decode(bytes.fromhex(line))
+        except ValueError as error:
+            print("bad frame {}: {}".format(line, error), file=sys.stderr)
+            continue
+        if values is None:
+            print("{:3d} waiting for keyframe".format(sequence))
+        else:
+            print("{:3d} {}".format(sequence, " ".join(
+                "{}={}".format(k, v) for k, v in values.items())))
+        sys.stdout.flush()
+    if decoder.lost:
+        print("lost frames: {}".format(decoder.lost), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
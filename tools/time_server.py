@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Answer the time requests of nodes, see clock.h.
+
+A node publishes its timer value on <base>time/request. This server answers on
+<base>time with that value, a space and the current time in milliseconds since
+the epoch, modulo 2^32.
+
+Requires the paho-mqtt package.
+"""
+
+import argparse
+import time
+
+import paho.mqtt.client as mqtt
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="localhost", help="MQTT broker")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--base", action="append",
+                        help="MQTT base name of a node, may be repeated (default: spider/)")
+    arguments = parser.parse_args()
+    bases = arguments.base or ["spider/"]
+
+    def on_connect(client, userdata, flags, rc):
+        for base in bases:
+            client.subscribe(base + "time/request")
+
+    def on_message(client, userdata, message):
+        now = int(time.time() * 1000) & 0xffffffff
+        base = message.topic[:-len("time/request")]
+        client.publish(base + "time", "{} {}".format(message.payload.decode("ascii", "replace"), now))
+
+    client = mqtt.Client()
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(arguments.host, arguments.port)
+    client.loop_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Inject faults into replayed esp-link traffic and measure how the node copes.
+
+The frames in docs/example_messages.txt, as esp-link sends them over the
+19200 baud UART, are replayed in random order and corrupted with bit flips,
+dropped bytes, spurious SLIP END (0xc0) bytes and truncated frames. The
+corrupted stream is fed to a model of the receiving side:
+
+  * SLIP decoding into a receive buffer of --buffer bytes; frames that don't
+    fit are dropped,
+  * the esp-link CRC check, as in the esp-link client,
+  * the dispatch of switch commands with the same strict checks as update()
+    in remotes.cpp.
+
+For every kind of fault the harness reports the fraction of frames lost, the
+frames lost per injected fault, the resynchronization time (from a fault to
+the end of the next frame that arrives intact), the number of frames that
+were merged with the next one because their END byte was lost, and the number
+of switch commands that were dispatched although they were never sent.
+
+A merged frame passes the CRC check: the esp-link CRC has no final XOR, so a
+packet followed by its own CRC leaves a zero remainder and the CRC of the
+second packet matches the whole. The first packet is dispatched and the
+second one is silently lost.
+
+This is a model: it follows the esp-link framing and the checks in the
+firmware, not the AVR code itself, so timing effects such as UART overruns
+during transmissions are not covered.
+"""
+
+import argparse
+import collections
+import os
+import random
+import re
+import struct
+
+SLIP_END = 0xc0
+SLIP_ESC = 0xdb
+SLIP_ESC_END = 0xdc
+SLIP_ESC_ESC = 0xdd
+
+# esp-link sends the MQTT data callback as a CMD_RESP_CB packet with the
+# callback number as value, see the examples.
+CMD_RESP_CB = 3
+DATA_CALLBACK = 2
+
+SWITCH_TOPIC = b"spider/switch/"
+
+BITS_PER_BYTE = 10
+BAUD = 19200
+
+
+def crc16(data):
+    """The CRC that esp-link appends to every packet, little-endian."""
+    acc = 0
+    for byte in data:
+        acc ^= byte
+        acc = ((acc >> 8) | (acc << 8)) & 0xffff
+        acc ^= (acc & 0xff00) << 4
+        acc &= 0xffff
+        acc ^= (acc >> 8) >> 4
+        acc ^= (acc & 0xff00) >> 5
+    return acc
+
+
+def slip_decode(encoded):
+    output = bytearray()
+    escaped = False
+    for byte in encoded:
+        if escaped:
+            output.append({SLIP_ESC_END: SLIP_END, SLIP_ESC_ESC: SLIP_ESC}.get(byte, byte))
+            escaped = False
+        elif byte == SLIP_ESC:
+            escaped = True
+        elif byte == SLIP_END:
+            break
+        else:
+            output.append(byte)
+    return bytes(output)
+
+
+def slip_encode(packet):
+    output = bytearray()
+    for byte in packet:
+        if byte == SLIP_END:
+            output += bytes((SLIP_ESC, SLIP_ESC_END))
+        elif byte == SLIP_ESC:
+            output += bytes((SLIP_ESC, SLIP_ESC_ESC))
+        else:
+            output.append(byte)
+    output.append(SLIP_END)
+    return bytes(output)
+
+
+def load_examples(path):
+    """Return the packets, including their CRC, in the examples file."""
+    packets = []
+    with open(path) as examples:
+        for line in examples:
+            if re.match(r"^[0-9a-fA-F]{2}\s", line):
+                packet = slip_decode(bytes(int(field, 16) for field in line.split()))
+                if crc16(packet[:-2]) != struct.unpack("<H", packet[-2:])[0]:
+                    raise ValueError("bad CRC in example: " + line.strip())
+                packets.append(packet)
+    return packets
+
+
+def parse_limits(source):
+    """Return the number of switches and the number of signals per switch in
+    the switches[] table of remotes.cpp."""
+    table = re.search(r"Switch\s+switches\[\]\s*=\s*\{(.*?)\n\};", source, re.S)
+    signals = re.search(r"signals\[(\d+)\]", source)
+    if not table or not signals:
+        raise ValueError("switches[] table not found")
+    return len(re.findall(r"\{\s*\w+\s*,\s*\{", table.group(1))), int(signals.group(1))
+
+
+def parse_strict(text, limit):
+    """Return the value of text as parse_strict() in remotes.cpp does: only
+    digits, at least one, at most 255 and less than limit. Returns None for
+    anything that parse_strict() rejects."""
+    if not text:
+        return None
+    result = 0
+    for byte in text:
+        digit = (byte - ord("0")) & 0xff
+        if digit > 9:
+            return None
+        result = 10 * result + digit
+        if result > 0xff:
+            return None
+    return result if result < limit else None
+
+
+def switch_command(packet, limits):
+    """Return (switch, action) if the packet is a switch command that update()
+    would queue, None otherwise. limits holds the number of switches and the
+    number of signals per switch."""
+    if len(packet) < 10:
+        return None
+    command, count, value = struct.unpack_from("<HHI", packet)
+    if command != CMD_RESP_CB or value != DATA_CALLBACK or count < 2:
+        return None
+    arguments = []
+    position = 8
+    end = len(packet) - 2
+    for _ in range(2):
+        if position + 2 > end:
+            return None
+        length, = struct.unpack_from("<H", packet, position)
+        data = packet[position + 2:position + 2 + length]
+        if len(data) != length:
+            return None
+        arguments.append(data)
+        position += (2 + length + 3) & ~3
+    topic, message = arguments
+    if not topic.startswith(SWITCH_TOPIC):
+        return None
+    switch = parse_strict(topic[len(SWITCH_TOPIC):], limits[0])
+    action = parse_strict(message, limits[1])
+    if switch is None or action is None:
+        return None
+    return switch, action
+
+
+class Receiver:
+    """Model of the esp-link client's receive path."""
+
+    def __init__(self, buffer_size):
+        self.buffer_size = buffer_size
+
+    def frames(self, stream):
+        """Yield (start, end, packet) for every packet that passes the CRC
+        check; start and end are byte positions in the stream."""
+        buffer = bytearray()
+        escaped = False
+        overflow = False
+        start = 0
+        for position, byte in enumerate(stream):
+            if byte == SLIP_END:
+                if not overflow and len(buffer) >= 10 and \
+                        crc16(buffer[:-2]) == buffer[-2] | buffer[-1] << 8:
+                    yield start, position, bytes(buffer)
+                buffer = bytearray()
+                escaped = False
+                overflow = False
+                start = position + 1
+                continue
+            if escaped:
+                byte = {SLIP_ESC_END: SLIP_END, SLIP_ESC_ESC: SLIP_ESC}.get(byte, byte)
+                escaped = False
+            elif byte == SLIP_ESC:
+                escaped = True
+                continue
+            if len(buffer) < self.buffer_size:
+                buffer.append(byte)
+            else:
+                overflow = True
+
+
+def inject(frames, kind, rate, rng):
+    """Corrupt the SLIP encoded frames. Returns the stream and the stream
+    positions at which faults were injected.
+
+    For byte faults rate is the probability per byte, for truncation the
+    probability per frame."""
+    stream = bytearray()
+    faults = []
+    for frame in frames:
+        if kind == "truncate":
+            if rng.random() < rate and len(frame) > 2:
+                faults.append(len(stream))
+                frame = frame[:rng.randrange(1, len(frame) - 1)] + bytes((SLIP_END,))
+            stream += frame
+            continue
+        for byte in frame:
+            if rng.random() >= rate:
+                stream.append(byte)
+                continue
+            faults.append(len(stream))
+            if kind == "flip":
+                stream.append(byte ^ (1 << rng.randrange(8)))
+            elif kind == "drop":
+                pass
+            elif kind == "end":
+                stream.append(SLIP_END)
+                stream.append(byte)
+    return bytes(stream), faults
+
+
+def run(packets, kind, rate, limits, arguments, rng):
+    sent = [rng.choice(packets) for _ in range(arguments.frames)]
+    stream, faults = inject([slip_encode(p) for p in sent], kind, rate, rng)
+
+    intact = []
+    merged = 0
+    misdispatched = 0
+    false_accepts = 0
+    expected = collections.Counter(sent)
+    for start, end, packet in Receiver(arguments.buffer).frames(stream):
+        if expected[packet]:
+            expected[packet] -= 1
+            intact.append((start, end))
+            continue
+
+        # without a final XOR, the CRC of a packet followed by its own CRC is
+        # zero, so when an END gets lost the CRC of the next packet makes the
+        # merged frame valid. The first packet is dispatched, the second lost.
+        first = next((p for p in packets if packet.startswith(p) and expected[p]), None)
+        if first is not None:
+            expected[first] -= 1
+            merged += 1
+            intact.append((start, end))
+        else:
+            false_accepts += 1
+            if switch_command(packet, limits) is not None:
+                misdispatched += 1
+
+    resync = []
+    starts = [start for start, _ in intact]
+    index = 0
+    for fault in faults:
+        while index < len(starts) and starts[index] <= fault:
+            index += 1
+        if index < len(intact):
+            resync.append((intact[index][1] - fault) * BITS_PER_BYTE * 1000.0 / BAUD)
+
+    lost = len(sent) - len(intact)
+    return {
+        "faults": len(faults),
+        "lost": lost,
+        "lost_fraction": lost / len(sent),
+        "lost_per_fault": lost / len(faults) if faults else 0.0,
+        "resync_mean_ms": sum(resync) / len(resync) if resync else 0.0,
+        "resync_max_ms": max(resync) if resync else 0.0,
+        "merged": merged,
+        "false_accepts": false_accepts,
+        "misdispatched": misdispatched,
+    }
+
+
+def main():
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir)
+    default_examples = os.path.join(root, "docs", "example_messages.txt")
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--examples", default=default_examples, help="esp-link frames to replay")
+    parser.add_argument("--source", default=os.path.join(root, "remotes.cpp"),
+                        help="firmware source with switches[]")
+    parser.add_argument("--frames", type=int, default=10000, help="frames per run")
+    parser.add_argument("--rate", type=float, action="append",
+                        help="fault probability per byte (per frame for truncation), "
+                             "may be repeated (default: 0.001 and 0.01)")
+    parser.add_argument("--buffer", type=int, default=128, help="receive buffer size in bytes")
+    parser.add_argument("--seed", type=int, default=1)
+    arguments = parser.parse_args()
+    rng = random.Random(arguments.seed)
+
+    packets = load_examples(arguments.examples)
+    with open(arguments.source) as source:
+        limits = parse_limits(source.read())
+    print("{:<9} {:>6} {:>7} {:>7} {:>9} {:>12} {:>9} {:>7} {:>13} {:>14}".format(
+        "fault", "rate", "faults", "lost", "lost/flt", "resync (ms)", "max (ms)", "merged",
+        "false accept", "misdispatched"))
+    for kind in ("flip", "drop", "end", "truncate"):
+        for rate in arguments.rate or [0.001, 0.01]:
+            result = run(packets, kind, rate, limits, arguments, rng)
+            print("{:<9} {:>6} {:>7} {:>6.2%} {:>9.2f} {:>12.1f} {:>9.1f} {:>7} {:>13} {:>14}".format(
+                kind, rate, result["faults"], result["lost_fraction"], result["lost_per_fault"],
+                result["resync_mean_ms"], result["resync_max_ms"], result["merged"],
+                result["false_accepts"], result["misdispatched"]))
+
+
+if __name__ == "__main__":
+    main()
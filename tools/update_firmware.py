@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2026 agent
+#
+#  Distributed under the Boost Software License, Version 1.0. (See
+#  accompanying file LICENSE_1_0.txt or copy at
+#  http://www.boost.org/LICENSE_1_0.txt)
+#
+"""Update the firmware of a node through the esp-link serial bridge.
+
+The node is asked to reset into its bootloader by publishing "update" on
+<base>firmware, after which the image is sent page by page over TCP port 23 of
+esp-link. Progress is printed and, when an MQTT broker is given, published on
+<base>firmware/status with mosquitto_pub.
+
+See bootloader/bootloader.cpp for the protocol. If an update is interrupted,
+the node stays in its bootloader and the tool can simply be run again.
+"""
+
+import argparse
+import collections
+import socket
+import subprocess
+import sys
+import time
+
+BOOT_START = 0x7800
+
+# precedes the hello and quit commands, see bootloader.cpp.
+SYNC = bytes((0xa5, 0x5a, 0x3c, 0xc3))
+
+
+def crc_xmodem(data, crc=0):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xffff
+    return crc
+
+
+def read_hex(path):
+    """Read an Intel HEX file into a bytearray that starts at address 0."""
+    image = bytearray()
+    base = 0
+    with open(path) as file:
+        for line in file:
+            line = line.strip()
+            if not line.startswith(":"):
+                continue
+            record = bytes.fromhex(line[1:])
+            if sum(record) & 0xff:
+                raise ValueError("checksum error in " + line)
+            count, address, kind = record[0], (record[1] << 8) | record[2], record[3]
+            data = record[4:4 + count]
+            if kind == 0:
+                start = base + address
+                if len(image) < start + count:
+                    image.extend(b"\xff" * (start + count - len(image)))
+                image[start:start + count] = data
+            elif kind == 1:
+                break
+            elif kind == 2:
+                base = ((data[0] << 8) | data[1]) << 4
+            elif kind == 4:
+                base = ((data[0] << 8) | data[1]) << 16
+    return image
+
+
+class Bootloader:
+    def __init__(self, host, port, timeout):
+        self.connection = socket.create_connection((host, port), timeout=timeout)
+
+    def read(self):
+        """Return the next byte from the node, or None on a timeout."""
+        try:
+            data = self.connection.recv(1)
+        except socket.timeout:
+            return None
+        if not data:
+            raise ConnectionError("esp-link closed the connection")
+        return data[0]
+
+    def expect(self, *responses):
+        """Skip bytes until one of the expected responses arrives."""
+        while True:
+            byte = self.read()
+            if byte is None or byte in responses:
+                return byte
+
+    def hello(self, attempts):
+        for _ in range(attempts):
+            self.connection.sendall(SYNC + b"H")
+            if self.expect(ord("B")) is not None:
+                page_size = self.read()
+                if page_size:
+                    return page_size
+        raise TimeoutError("no response from the bootloader")
+
+    def drain(self):
+        """Discard everything the node sends until it falls silent."""
+        while self.read() is not None:
+            pass
+
+    def write_pages(self, pages, progress, window=2, retries=5):
+        """Write a list of (address, data) pages.
+
+        Up to window frames are sent before their acknowledgements arrive, so
+        that the serial line stays busy while the bootloader answers. The first
+        frame is sent on its own, because the bootloader may erase page 0 before
+        it can receive again. After a rejected or unanswered frame, the tool
+        waits for silence and continues from that frame. progress is called
+        with the number of pages written so far.
+        """
+        outstanding = collections.deque()
+        index = 0
+        failures = 0
+        pipelined = False
+        while index < len(pages) or outstanding:
+            while index < len(pages) and len(outstanding) < (window if pipelined else 1):
+                address, data = pages[index]
+                frame = bytes([address >> 8, address & 0xff]) + data
+                crc = crc_xmodem(frame)
+                self.connection.sendall(b"W" + frame + bytes([crc >> 8, crc & 0xff]))
+                outstanding.append(index)
+                index += 1
+
+            sent = outstanding.popleft()
+            if self.expect(ord("K"), ord("E")) == ord("K"):
+                failures = 0
+                pipelined = True
+                progress(sent + 1)
+                continue
+
+            failures += 1
+            if failures > retries:
+                raise IOError("page at {:04x} not accepted".format(pages[sent][0]))
+            self.drain()
+            outstanding.clear()
+            index = sent
+            pipelined = False
+
+    def quit(self):
+        self.connection.sendall(SYNC + b"Q")
+        response = self.expect(ord("K"), ord("E"))
+        if response is None:
+            raise TimeoutError("no response to quit")
+        if response == ord("E"):
+            raise IOError("the bootloader found no application to start")
+
+
+class Status:
+    def __init__(self, mqtt_host, topic):
+        self.mqtt_host = mqtt_host
+        self.topic = topic
+
+    def publish(self, message):
+        print(message)
+        if self.mqtt_host:
+            subprocess.call(["mosquitto_pub", "-h", self.mqtt_host,
+                             "-t", self.topic, "-m", message])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("esp_link", help="address of the esp-link of the node")
+    parser.add_argument("hexfile", help="application image in Intel HEX format")
+    parser.add_argument("--port", type=int, default=23, help="esp-link serial bridge port")
+    parser.add_argument("--mqtt-host", help="MQTT broker, to request the update and report progress")
+    parser.add_argument("--base", default="spider/", help="MQTT base name of the node")
+    parser.add_argument("--timeout", type=float, default=2.0, help="response timeout in seconds")
+    arguments = parser.parse_args()
+
+    image = read_hex(arguments.hexfile)
+    if len(image) > BOOT_START:
+        sys.exit("image overlaps the bootloader")
+
+    status = Status(arguments.mqtt_host, arguments.base + "firmware/status")
+    bootloader = Bootloader(arguments.esp_link, arguments.port, arguments.timeout)
+    if arguments.mqtt_host:
+        subprocess.check_call(["mosquitto_pub", "-h", arguments.mqtt_host,
+                               "-t", arguments.base + "firmware", "-m", "update"])
+    page_size = bootloader.hello(attempts=10)
+
+    start = time.time()
+
+    # page 0 holds the reset vector and goes last: the bootloader erases it
+    # before the first other page is written, so an interrupted update leaves
+    # the node waiting in the bootloader instead of running half an image.
+    addresses = list(range(page_size, len(image), page_size)) + [0]
+    pages = []
+    for address in addresses:
+        data = bytes(image[address:address + page_size])
+        pages.append((address, data + b"\xff" * (page_size - len(data))))
+
+    reported = [-1]
+
+    def progress(written):
+        percentage = 100 * written // len(pages)
+        if percentage // 10 != reported[0]:
+            reported[0] = percentage // 10
+            status.publish("{}%".format(percentage))
+
+    bootloader.write_pages(pages, progress)
+    bootloader.quit()
+
+    status.publish("done, {} bytes in {:.1f}s".format(len(image), time.time() - start))
+
+
+if __name__ == "__main__":
+    main()